@@ -14,6 +14,113 @@ extern "C" {
 
 ZVMC_EXPORT struct zvmc_vm* zvmc_create_zvmone(void) ZVMC_NOEXCEPT;
 
+/**
+ * Accesses the storage slot (as access_storage) and loads its value (as get_storage).
+ *
+ * @param context  The host context.
+ * @param address  The address of the account.
+ * @param key      The index of the storage slot.
+ * @param value    The pointer to the slot value output.
+ * @return         The access status of the slot before the access.
+ */
+typedef enum zvmc_access_status (*zvmone_access_and_get_storage_fn)(
+    struct zvmc_host_context* context,
+    const zvmc_address* address,
+    const zvmc_bytes32* key,
+    zvmc_bytes32* value);
+
+/**
+ * Accesses the storage slot (as access_storage) and updates its value (as set_storage).
+ *
+ * @param context  The host context.
+ * @param address  The address of the account.
+ * @param key      The index of the storage slot.
+ * @param value    The new value of the slot.
+ * @param status   The pointer to the storage status output (as returned by set_storage).
+ * @return         The access status of the slot before the access.
+ */
+typedef enum zvmc_access_status (*zvmone_access_and_set_storage_fn)(
+    struct zvmc_host_context* context,
+    const zvmc_address* address,
+    const zvmc_bytes32* key,
+    const zvmc_bytes32* value,
+    enum zvmc_storage_status* status);
+
+/** The answers of the host to the checks preceding a call or a contract creation. */
+struct zvmone_call_preflight
+{
+    /** The access status of the destination account before the access (as access_account). */
+    enum zvmc_access_status access_status;
+
+    /** Whether the destination account exists (as account_exists). */
+    bool account_exists;
+
+    /** Whether the sender balance is not lower than the transferred value. */
+    bool balance_sufficient;
+};
+
+/**
+ * Answers all checks preceding a call or a contract creation in a single host call.
+ *
+ * @param context      The host context.
+ * @param sender       The address of the sender account.
+ * @param destination  The address of the destination account of the call (accessed as
+ *                     by access_account) or NULL for the contract creation.
+ *                     Then access_status and account_exists are not set.
+ * @param value        The transferred value.
+ * @param result       The pointer to the preflight output.
+ */
+typedef void (*zvmone_call_preflight_fn)(struct zvmc_host_context* context,
+    const zvmc_address* sender,
+    const zvmc_address* destination,
+    const zvmc_uint256be* value,
+    struct zvmone_call_preflight* result);
+
+/**
+ * The optional zvmone extension of the ZVMC host interface.
+ *
+ * The fused operations replace the sequences of the host calls of SLOAD, SSTORE and
+ * the call instructions so the host can look up the storage slot or the account once.
+ * The storage functions must be provided. The other functions are optional (may be NULL).
+ *
+ * New members are only appended. The members not covered by the size set by the host
+ * (e.g. built against an older version of this header) are treated as NULL.
+ */
+struct zvmone_host_extension
+{
+    /** The size of the struct as known to the host: sizeof(struct zvmone_host_extension). */
+    size_t size;
+
+    zvmone_access_and_get_storage_fn access_and_get_storage;
+    zvmone_access_and_set_storage_fn access_and_set_storage;
+
+    /** Optional. Added after the storage functions. */
+    zvmone_call_preflight_fn call_preflight;
+};
+
+/**
+ * Registers the host extension for the executions with the given host interface.
+ *
+ * The extension is registered per host interface identified by its address, so the host should
+ * register its own copy of the interface, not one shared with other hosts. Up to 8 host
+ * interfaces can have extensions registered in a VM at a time. Registering again for the same
+ * host interface replaces its extension. Passing NULL extension unregisters it.
+ *
+ * A host should register its extension once, when setting up the VM. The registration must
+ * not be done while the VM executes with the same host interface in other threads.
+ * The executions with other host interfaces are not affected.
+ *
+ * @param vm         The zvmone VM instance.
+ * @param host       The host interface the extension is used with.
+ * @param extension  The host extension. It is copied so it does not have to outlive the call.
+ * @return           True if the extension has been registered. False if it is NULL, misses
+ *                   the storage functions or the limit of the registered host interfaces
+ *                   has been reached.
+ */
+ZVMC_EXPORT bool zvmone_set_host_extension(struct zvmc_vm* vm,
+    const struct zvmc_host_interface* host,
+    const struct zvmone_host_extension* extension) ZVMC_NOEXCEPT;
+
 #if __cplusplus
 }
 #endif
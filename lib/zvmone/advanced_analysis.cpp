@@ -3,8 +3,11 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "advanced_analysis.hpp"
+#include "instructions.hpp"
 #include "opcodes_helpers.h"
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace zvmone::advanced
 {
@@ -16,6 +19,41 @@ inline constexpr To clamp(T x) noexcept
     return x <= max ? static_cast<To>(x) : max;
 }
 
+bool is_pure(uint8_t opcode) noexcept
+{
+    switch (opcode)
+    {
+    case OP_ADD:
+    case OP_MUL:
+    case OP_SUB:
+    case OP_DIV:
+    case OP_SDIV:
+    case OP_MOD:
+    case OP_SMOD:
+    case OP_ADDMOD:
+    case OP_MULMOD:
+    case OP_EXP:
+    case OP_SIGNEXTEND:
+    case OP_LT:
+    case OP_GT:
+    case OP_SLT:
+    case OP_SGT:
+    case OP_EQ:
+    case OP_ISZERO:
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+    case OP_NOT:
+    case OP_BYTE:
+    case OP_SHL:
+    case OP_SHR:
+    case OP_SAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
 struct BlockAnalysis
 {
     int64_t gas_cost = 0;
@@ -39,24 +77,416 @@ struct BlockAnalysis
     }
 };
 
-AdvancedCodeAnalysis analyze(zvmc_revision rev, bytes_view code) noexcept
+/// The symbolic execution of a sequence of DUP/SWAP/POP instructions.
+///
+/// The stack items are identified by their positions relative to the stack top
+/// at the beginning of the sequence. Only the items touched by the sequence are tracked.
+/// The deeper items are not modified.
+struct ShuffleAnalysis
+{
+    /// The tracked stack items, the top item first.
+    std::array<uint8_t, StackShuffle::max_size> items{};
+
+    /// The number of the tracked stack items.
+    int size = 0;
+
+    /// The number of the stack items from before the sequence reached by the sequence.
+    int num_inputs = 0;
+
+    /// The number of instructions in the sequence.
+    int num_instrs = 0;
+
+    /// The index of the first instruction of the sequence.
+    size_t begin_index = 0;
+
+    explicit ShuffleAnalysis(size_t index) noexcept : begin_index{index} {}
+
+    /// Applies the instruction to the symbolic stack.
+    /// Returns false if the shuffle size limit is exceeded. The instruction is not applied then
+    /// and the shuffle of the sequence is not changed.
+    [[nodiscard]] bool apply(uint8_t opcode) noexcept
+    {
+        constexpr auto max_size = static_cast<int>(StackShuffle::max_size);
+
+        if (opcode == OP_POP)
+        {
+            if (!reach(0))
+                return false;
+            std::copy(&items[1], &items[static_cast<size_t>(size)], &items[0]);
+            --size;
+        }
+        else if (opcode >= OP_DUP1 && opcode <= OP_DUP16)
+        {
+            const auto n = opcode - OP_DUP1 + 1;
+            if (!reach(n - 1) || size == max_size)
+                return false;
+            std::copy_backward(&items[0], &items[static_cast<size_t>(size)],
+                &items[static_cast<size_t>(size) + 1]);
+            ++size;
+            items[0] = items[static_cast<size_t>(n)];
+        }
+        else
+        {
+            assert(opcode >= OP_SWAP1 && opcode <= OP_SWAP16);
+            const auto n = opcode - OP_SWAP1 + 1;
+            if (!reach(n))
+                return false;
+            std::swap(items[0], items[static_cast<size_t>(n)]);
+        }
+        ++num_instrs;
+        return true;
+    }
+
+    /// Creates the stack shuffle for the sequence.
+    [[nodiscard]] StackShuffle close() const noexcept
+    {
+        StackShuffle shuffle;
+        shuffle.num_instrs = num_instrs;
+        shuffle.height_change = static_cast<int8_t>(size - num_inputs);
+
+        // Skip the bottom items which end up in their original positions.
+        auto out_size = size;
+        while (out_size > 0 &&
+               items[static_cast<size_t>(out_size - 1)] == out_size - 1 - shuffle.height_change)
+            --out_size;
+
+        shuffle.size = static_cast<uint8_t>(out_size);
+        std::copy_n(items.begin(), out_size, shuffle.src.begin());
+        return shuffle;
+    }
+
+private:
+    /// Starts tracking the stack items up to the given position.
+    [[nodiscard]] bool reach(int pos) noexcept
+    {
+        constexpr auto max_size = static_cast<int>(StackShuffle::max_size);
+        if (pos >= max_size || num_inputs + (pos + 1 - size) > max_size)
+            return false;
+
+        // The untracked items are in their original order below the tracked ones.
+        while (size <= pos)
+            items[static_cast<size_t>(size++)] = static_cast<uint8_t>(num_inputs++);
+        return true;
+    }
+};
+
+std::optional<StackShuffle> compute_stack_shuffle(bytes_view opcodes) noexcept
+{
+    auto shuffle = ShuffleAnalysis{0};
+    for (const auto op : opcodes)
+    {
+        if ((op != OP_POP && (op < OP_DUP1 || op > OP_SWAP16)) || !shuffle.apply(op))
+            return {};
+    }
+    return shuffle.close();
+}
+
+/// The analysis of the stack items with values known at analysis time in a basic block.
+///
+/// The instructions computing constant values from constant inputs are replaced with
+/// the OPX_PUSH_CONSTANT pushing the result. The DIV/MOD/MUL by a power of two
+/// are replaced with shifts and masks. The base gas cost of the replaced instructions is still
+/// charged by the block, the dynamic cost of the folded EXP is added to the block cost.
+class ConstantAnalysis
+{
+    static constexpr auto no_range = std::numeric_limits<size_t>::max();
+
+    struct Item
+    {
+        bool known = false;
+        uint256 value;
+
+        /// The range of the instructions which only effect is pushing the value to the stack
+        /// (e.g. PUSH, DUP of a known value or already folded instructions).
+        /// The instructions in the range can be replaced with OPX_PUSH_CONSTANT.
+        size_t begin = no_range;
+        size_t end = no_range;
+    };
+
+    /// The items at the top of the stack, the top item last. The deeper items are unknown.
+    std::vector<Item> m_items;
+
+public:
+    /// Forgets all items, e.g. at the beginning of a block which may be a jump destination.
+    void reset() noexcept { m_items.clear(); }
+
+    /// Analyzes the last instruction of the analysis.
+    void analyze(AdvancedCodeAnalysis& analysis, BlockAnalysis& block, uint8_t opcode,
+        const OpTableEntry& opcode_info) noexcept
+    {
+        const auto index = analysis.instrs.size() - 1;
+        auto& instr = analysis.instrs.back();
+
+        if (opcode == OP_PUSH0 || (opcode >= OP_PUSH1 && opcode <= OP_PUSH32))
+        {
+            const auto value = (opcode == OP_PUSH0) ? uint256{0} :
+                               (opcode <= OP_PUSH8) ? uint256{instr.arg.small_push_value} :
+                                                      *instr.arg.push_value;
+            m_items.push_back({true, value, index, index});
+        }
+        else if (opcode >= OP_DUP1 && opcode <= OP_DUP16)
+        {
+            const auto n = size_t{opcode} - OP_DUP1 + 1;
+            auto item = (m_items.size() >= n) ? m_items[m_items.size() - n] : Item{};
+            item.begin = item.end = item.known ? index : no_range;
+            m_items.push_back(item);
+        }
+        else if (opcode >= OP_SWAP1 && opcode <= OP_SWAP16)
+        {
+            const auto n = size_t{opcode} - OP_SWAP1 + 1;
+            if (m_items.size() <= n)
+                m_items.insert(m_items.begin(), n + 1 - m_items.size(), Item{});
+            auto& a = m_items[m_items.size() - 1];
+            auto& b = m_items[m_items.size() - 1 - n];
+            std::swap(a, b);
+            a.begin = a.end = b.begin = b.end = no_range;
+        }
+        else
+        {
+            const auto num_inputs = static_cast<size_t>(opcode_info.stack_req);
+            const auto num_outputs = static_cast<size_t>(num_inputs + opcode_info.stack_change);
+            auto result = Item{};
+
+            if (is_pure(opcode) && num_inputs <= m_items.size())
+            {
+                const auto inputs = &m_items[m_items.size() - num_inputs];
+                if (std::all_of(inputs, inputs + num_inputs, [](const Item& i) { return i.known; }))
+                    result = fold(analysis, block, opcode, inputs, num_inputs, index);
+                else
+                    reduce_strength(instr, opcode, inputs, num_inputs);
+            }
+
+            if (num_inputs <= m_items.size())
+                m_items.resize(m_items.size() - num_inputs);
+            else
+                m_items.clear();
+            if (num_outputs == 1)
+                m_items.push_back(result);
+            else
+                m_items.insert(m_items.end(), num_outputs, Item{});
+        }
+    }
+
+private:
+    /// Computes the result of the pure instruction and replaces the instructions computing it
+    /// with OPX_PUSH_CONSTANT if they only operate on the known inputs.
+    static Item fold(AdvancedCodeAnalysis& analysis, BlockAnalysis& block, uint8_t opcode,
+        const Item* inputs, size_t num_inputs, size_t index) noexcept
+    {
+        uint256 stack[3];
+        for (size_t i = 0; i < num_inputs; ++i)
+            stack[i] = inputs[i].value;
+
+        // Use the instruction implementations. The result is always in the deepest input slot.
+        const StackTop top{&stack[num_inputs - 1]};
+        switch (opcode)
+        {
+        case OP_ADD:
+            instr::core::add(top);
+            break;
+        case OP_MUL:
+            instr::core::mul(top);
+            break;
+        case OP_SUB:
+            instr::core::sub(top);
+            break;
+        case OP_DIV:
+            instr::core::div(top);
+            break;
+        case OP_SDIV:
+            instr::core::sdiv(top);
+            break;
+        case OP_MOD:
+            instr::core::mod(top);
+            break;
+        case OP_SMOD:
+            instr::core::smod(top);
+            break;
+        case OP_ADDMOD:
+            instr::core::addmod(top);
+            break;
+        case OP_MULMOD:
+            stack[0] = stack[0] != 0 ? intx::mulmod(stack[2], stack[1], stack[0]) : 0;
+            break;
+        case OP_EXP:
+            stack[0] = intx::exp(stack[1], stack[0]);
+            break;
+        case OP_SIGNEXTEND:
+            instr::core::signextend(top);
+            break;
+        case OP_LT:
+            instr::core::lt(top);
+            break;
+        case OP_GT:
+            instr::core::gt(top);
+            break;
+        case OP_SLT:
+            instr::core::slt(top);
+            break;
+        case OP_SGT:
+            instr::core::sgt(top);
+            break;
+        case OP_EQ:
+            instr::core::eq(top);
+            break;
+        case OP_ISZERO:
+            instr::core::iszero(top);
+            break;
+        case OP_AND:
+            instr::core::and_(top);
+            break;
+        case OP_OR:
+            instr::core::or_(top);
+            break;
+        case OP_XOR:
+            instr::core::xor_(top);
+            break;
+        case OP_NOT:
+            instr::core::not_(top);
+            break;
+        case OP_BYTE:
+            instr::core::byte(top);
+            break;
+        case OP_SHL:
+            instr::core::shl(top);
+            break;
+        case OP_SHR:
+            instr::core::shr(top);
+            break;
+        case OP_SAR:
+            instr::core::sar(top);
+            break;
+        default:
+            assert(false);
+        }
+
+        // The inputs must be pushed by the instructions directly preceding this one.
+        auto expected_end = index - 1;
+        for (size_t i = num_inputs; i-- > 0;)
+        {
+            if (inputs[i].end != expected_end)
+                return {true, stack[0]};
+            expected_end = inputs[i].begin - 1;
+        }
+        const auto begin = inputs[0].begin;
+
+        if (opcode == OP_EXP)
+        {
+            // Charge the dynamic cost of the folded EXP with the block cost.
+            const auto exponent_size = intx::count_significant_bytes(inputs[0].value);
+            block.gas_cost += instr::exp_byte_cost * static_cast<int64_t>(exponent_size);
+        }
+
+        auto& first = analysis.instrs[begin];
+        const auto num_instrs = static_cast<int32_t>(index + 1 - begin);
+        if (first.fn == opx_push_constant)  // Extend the already folded range.
+        {
+            analysis.folded_constants[static_cast<size_t>(first.arg.number)] = {
+                stack[0], num_instrs};
+        }
+        else
+        {
+            first.fn = opx_push_constant;
+            first.arg.number = static_cast<int64_t>(analysis.folded_constants.size());
+            analysis.folded_constants.push_back({stack[0], num_instrs});
+        }
+        return {true, stack[0], begin, index};
+    }
+
+    /// Replaces the DIV/MOD/MUL instruction by a power of two with a shift or a mask.
+    static void reduce_strength(
+        Instruction& instr, uint8_t opcode, const Item* inputs, size_t num_inputs) noexcept
+    {
+        if (num_inputs != 2)
+            return;
+
+        const auto log2 = [](const Item& item) noexcept {
+            return (item.known && item.value != 0 && (item.value & (item.value - 1)) == 0) ?
+                       int64_t{255} - intx::clz(item.value) :
+                       int64_t{-1};
+        };
+
+        // The inputs[1] is the stack top.
+        if (opcode == OP_DIV || opcode == OP_MOD)
+        {
+            if (const auto k = log2(inputs[0]); k >= 0)
+            {
+                instr.fn = (opcode == OP_DIV) ? opx_div_pow2 : opx_mod_pow2;
+                instr.arg.number = k;
+            }
+        }
+        else if (opcode == OP_MUL)
+        {
+            // Encode the position of the other factor in the argument.
+            if (const auto k = log2(inputs[1]); k >= 0)
+            {
+                instr.fn = opx_mul_pow2;
+                instr.arg.number = k | (int64_t{1} << 8);
+            }
+            else if (const auto k0 = log2(inputs[0]); k0 >= 0)
+            {
+                instr.fn = opx_mul_pow2;
+                instr.arg.number = k0;
+            }
+        }
+    }
+};
+
+AdvancedCodeAnalysis analyze(zvmc_revision rev, bytes_view code, bool with_trace_info) noexcept
 {
     const auto& op_tbl = get_op_table(rev);
     const auto opx_beginblock_fn = op_tbl[OPX_BEGINBLOCK].fn;
 
     AdvancedCodeAnalysis analysis;
 
-    const auto max_instrs_size = code.size() + 2;  // Additional OPX_BEGINBLOCK and STOP
+    // Count the instructions and the large push values first to allocate the exact storage.
+    // The PUSH data bytes are skipped so this usually saves 1/3 of instructions storage.
+    // The push_values must be preallocated because instructions point to its elements.
+    size_t num_opcodes = 0;
+    size_t num_large_pushes = 0;
+    for (size_t i = 0; i < code.size(); ++i, ++num_opcodes)
+    {
+        const auto op = code[i];
+        if (op >= OP_PUSH1 && op <= OP_PUSH32)
+        {
+            num_large_pushes += (op >= OP_PUSH9);
+            i += op - size_t{OP_PUSH1 - 1};  // Skip PUSH data.
+        }
+    }
+
+    const auto max_instrs_size = num_opcodes + 2;  // Additional OPX_BEGINBLOCK and STOP
     analysis.instrs.reserve(max_instrs_size);
 
-    // This is 2x more than needed but using (code.size() / 2 + 1) increases page-faults 1000x.
-    const auto max_args_storage_size = code.size() + 1;
+    const auto max_args_storage_size = num_large_pushes;
     analysis.push_values.reserve(max_args_storage_size);
 
+    if (with_trace_info)
+        analysis.trace_info.reserve(max_instrs_size);
+
     // Create first block.
     analysis.instrs.emplace_back(opx_beginblock_fn);
+    if (with_trace_info)
+        analysis.trace_info.emplace_back();  // Intrinsic instruction.
     auto block = BlockAnalysis{0};
 
+    // The sequences of DUP/SWAP/POP instructions are replaced with stack shuffles
+    // and the constant expressions are folded.
+    // This is not done when tracing because all instructions must be executed one by one.
+    // The block requirements are not affected because the shuffle only touches the stack items
+    // the original instructions do.
+    auto shuffle = ShuffleAnalysis{0};
+    ConstantAnalysis constant_analysis;
+    const auto close_shuffle = [&analysis, &shuffle]() noexcept {
+        if (shuffle.num_instrs >= 2)
+        {
+            auto& instr = analysis.instrs[shuffle.begin_index];
+            instr.fn = opx_shuffle;
+            instr.arg.number = static_cast<int64_t>(analysis.stack_shuffles.size());
+            analysis.stack_shuffles.emplace_back(shuffle.close());
+        }
+        shuffle = ShuffleAnalysis{analysis.instrs.size()};
+    };
+
     // TODO: Iterators are not used here because because push_end may point way outside of code
     //       and this is not allowed and MSVC will detect it with instrumented iterators.
     const auto code_begin = code.data();
@@ -74,12 +504,36 @@ AdvancedCodeAnalysis analyze(zvmc_revision rev, bytes_view code) noexcept
             // Create new block.
             block = BlockAnalysis{analysis.instrs.size()};
 
+            constant_analysis.reset();
+
             // The JUMPDEST is always the first instruction in the block.
             analysis.jumpdest_offsets.emplace_back(static_cast<int32_t>(code_pos - code_begin - 1));
             analysis.jumpdest_targets.emplace_back(static_cast<int32_t>(analysis.instrs.size()));
         }
 
+        if (!with_trace_info)
+        {
+            if (opcode == OP_POP || (opcode >= OP_DUP1 && opcode <= OP_SWAP16))
+            {
+                if (shuffle.num_instrs == 0)
+                    shuffle.begin_index = analysis.instrs.size();
+                if (!shuffle.apply(opcode))
+                {
+                    close_shuffle();
+                    [[maybe_unused]] const auto applied = shuffle.apply(opcode);
+                    assert(applied);  // The single instruction always fits a shuffle.
+                }
+            }
+            else
+                close_shuffle();
+        }
+
         analysis.instrs.emplace_back(opcode_info.fn);
+        if (with_trace_info)
+        {
+            analysis.trace_info.push_back(
+                {static_cast<int32_t>(code_pos - code_begin - 1), block.gas_cost});
+        }
 
         block.stack_req = std::max(block.stack_req, opcode_info.stack_req - block.stack_change);
         block.stack_change += opcode_info.stack_change;
@@ -177,20 +631,42 @@ AdvancedCodeAnalysis analyze(zvmc_revision rev, bytes_view code) noexcept
             instr.arg.number = code_pos - code_begin - 1;
             break;
         }
+
+        if (!with_trace_info)
+            constant_analysis.analyze(analysis, block, opcode, opcode_info);
     }
 
     // Save current block.
     analysis.instrs[block.begin_block_index].arg.block = block.close();
+    close_shuffle();
 
     // Make sure the last block is terminated.
     // TODO: This is not needed if the last instruction is a terminating one.
     analysis.instrs.emplace_back(op_tbl[OP_STOP].fn);
+    if (with_trace_info)
+        analysis.trace_info.emplace_back();  // Intrinsic instruction.
 
     assert(analysis.instrs.size() <= max_instrs_size);
 
     // Make sure the push_values has not been reallocated. Otherwise iterators are invalid.
     assert(analysis.push_values.size() <= max_args_storage_size);
 
+    // Build the dense jump table if the JUMPDESTs are dense enough and it fits the size limit.
+    if (const auto num_jumpdests = analysis.jumpdest_offsets.size(); num_jumpdests != 0)
+    {
+        const auto jump_table_size = static_cast<size_t>(analysis.jumpdest_offsets.back()) + 1;
+        if (jump_table_size <= max_jump_table_size &&
+            jump_table_size <= num_jumpdests * max_jump_table_sparsity)
+        {
+            analysis.jump_table.assign(jump_table_size, 0);
+            for (size_t i = 0; i < num_jumpdests; ++i)
+            {
+                analysis.jump_table[static_cast<size_t>(analysis.jumpdest_offsets[i])] =
+                    static_cast<uint16_t>(analysis.jumpdest_targets[i] + 1);
+            }
+        }
+    }
+
     return analysis;
 }
 
@@ -10,6 +10,8 @@
 #include <zvmc/zvmc.hpp>
 #include <array>
 #include <cstdint>
+#include <limits>
+#include <optional>
 #include <vector>
 
 namespace zvmone::advanced
@@ -91,9 +93,9 @@ struct AdvancedExecutionState : ExecutionState
     AdvancedExecutionState() noexcept : stack{stack_space.bottom()} {}
 
     AdvancedExecutionState(const zvmc_message& message, zvmc_revision revision,
-        const zvmc_host_interface& host_interface, zvmc_host_context* host_ctx,
-        bytes_view _code) noexcept
-      : ExecutionState{message, revision, host_interface, host_ctx, _code},
+        const zvmc_host_interface& host_interface, zvmc_host_context* host_ctx, bytes_view _code,
+        bool shared_stack = false) noexcept
+      : ExecutionState{message, revision, host_interface, host_ctx, _code, shared_stack},
         gas_left{message.gas},
         stack{stack_space.bottom()}
     {}
@@ -145,6 +147,31 @@ enum intrinsic_opcodes
     OPX_BEGINBLOCK = OP_JUMPDEST
 };
 
+/// The OPX_SHUFFLE intrinsic instruction.
+///
+/// It replaces the first instruction of a sequence of DUP/SWAP/POP instructions and applies their
+/// net effect on the stack described by the StackShuffle indexed by the instruction argument.
+/// The remaining instructions of the sequence are skipped. It does not have an opcode because
+/// it is never present in the code.
+const Instruction* opx_shuffle(const Instruction* instr, AdvancedExecutionState& state) noexcept;
+
+/// The OPX_PUSH_CONSTANT intrinsic instruction.
+///
+/// It replaces the first instruction of a sequence computing a constant value and pushes
+/// the FoldedConstant indexed by the instruction argument. The rest of the sequence is skipped.
+const Instruction* opx_push_constant(
+    const Instruction* instr, AdvancedExecutionState& state) noexcept;
+
+/// The DIV by 2^k replaced with the right shift by k (the instruction argument).
+const Instruction* opx_div_pow2(const Instruction* instr, AdvancedExecutionState& state) noexcept;
+
+/// The MOD by 2^k replaced with the mask of k low bits (the instruction argument).
+const Instruction* opx_mod_pow2(const Instruction* instr, AdvancedExecutionState& state) noexcept;
+
+/// The MUL by 2^k replaced with the left shift by k. The instruction argument contains k
+/// in the low 8 bits and the stack position of the other factor in the next bits.
+const Instruction* opx_mul_pow2(const Instruction* instr, AdvancedExecutionState& state) noexcept;
+
 struct OpTableEntry
 {
     instruction_exec_fn fn;
@@ -163,6 +190,51 @@ struct Instruction
     explicit constexpr Instruction(instruction_exec_fn f) noexcept : fn{f}, arg{} {}
 };
 
+/// The information about an instruction needed to report it to a tracer.
+struct InstructionTraceInfo
+{
+    /// The offset of the instruction in the code.
+    /// Negative for intrinsic instructions not present in the code.
+    int32_t offset = -1;
+
+    /// The total base gas cost of the preceding instructions in the basic block.
+    int64_t block_gas_cost = 0;
+};
+
+/// The stack shuffle: the net effect of a sequence of DUP/SWAP/POP instructions
+/// in a basic block executed as a single instruction.
+struct StackShuffle
+{
+    /// The maximum number of the stack items tracked by a shuffle.
+    static constexpr size_t max_size = 24;
+
+    /// The number of the replaced instructions. The execution continues after them.
+    int32_t num_instrs = 0;
+
+    /// The stack height change.
+    int8_t height_change = 0;
+
+    /// The number of the top stack items written by the shuffle.
+    uint8_t size = 0;
+
+    /// The positions (relative to the stack top before the shuffle) of the items
+    /// to be written to the top stack items.
+    std::array<uint8_t, max_size> src{};
+
+    friend bool operator==(const StackShuffle&, const StackShuffle&) = default;
+};
+
+/// The constant value computed at analysis time replacing the instructions computing it.
+struct FoldedConstant
+{
+    intx::uint256 value;
+
+    /// The number of the replaced instructions. The execution continues after them.
+    int32_t num_instrs = 0;
+
+    friend bool operator==(const FoldedConstant&, const FoldedConstant&) = default;
+};
+
 struct AdvancedCodeAnalysis
 {
     std::vector<Instruction> instrs;
@@ -179,10 +251,45 @@ struct AdvancedCodeAnalysis
     /// matching the elements from jumdest_offsets.
     /// This is value to which the next instruction pointer must be set in JUMP/JUMPI.
     std::vector<int32_t> jumpdest_targets;
+
+    /// The dense jump table mapping code offsets to the indexes of the instructions plus 1,
+    /// or 0 for invalid jump destinations.
+    /// It covers the code offsets up to the last JUMPDEST. It is only built if the code has
+    /// enough JUMPDESTs (see max_jump_table_sparsity) and the table does not exceed
+    /// max_jump_table_size.
+    std::vector<uint16_t> jump_table;
+
+    /// The stack shuffles referenced by the OPX_SHUFFLE instructions.
+    std::vector<StackShuffle> stack_shuffles;
+
+    /// The constants referenced by the OPX_PUSH_CONSTANT instructions.
+    std::vector<FoldedConstant> folded_constants;
+
+    /// The tracing information matching the elements of instrs.
+    /// This is only filled if requested by analyze() and is used by the tracing execution loop.
+    std::vector<InstructionTraceInfo> trace_info;
 };
 
+/// The maximum number of entries of the AdvancedCodeAnalysis::jump_table.
+/// This is the EIP-170 code size limit so deployed contracts always use the table
+/// while larger code (e.g. init code) falls back to the binary search.
+inline constexpr size_t max_jump_table_size = 0x6000;
+
+/// The maximum number of the AdvancedCodeAnalysis::jump_table entries per JUMPDEST.
+/// The code with sparse JUMPDESTs uses the binary search instead of the table.
+inline constexpr size_t max_jump_table_sparsity = 32;
+
+// The instruction index of a JUMPDEST is at most its code offset + 1.
+static_assert(max_jump_table_size + 2 <= std::numeric_limits<uint16_t>::max());
+
 inline int find_jumpdest(const AdvancedCodeAnalysis& analysis, int offset) noexcept
 {
+    if (const auto& table = analysis.jump_table; !table.empty())
+    {
+        const auto index = static_cast<size_t>(offset);
+        return index < table.size() ? int{table[index]} - 1 : -1;
+    }
+
     const auto begin = std::begin(analysis.jumpdest_offsets);
     const auto end = std::end(analysis.jumpdest_offsets);
     const auto it = std::lower_bound(begin, end, offset);
@@ -191,8 +298,23 @@ inline int find_jumpdest(const AdvancedCodeAnalysis& analysis, int offset) noexc
                -1;
 }
 
-ZVMC_EXPORT AdvancedCodeAnalysis analyze(zvmc_revision rev, bytes_view code) noexcept;
+/// Analyzes the code for the Advanced interpreter.
+///
+/// @param rev              The ZVM revision.
+/// @param code             The ZVM bytecode.
+/// @param with_trace_info  Whether to build AdvancedCodeAnalysis::trace_info needed for tracing.
+///                         This also disables the optimizations merging instructions.
+ZVMC_EXPORT AdvancedCodeAnalysis analyze(
+    zvmc_revision rev, bytes_view code, bool with_trace_info = false) noexcept;
 
 ZVMC_EXPORT const OpTable& get_op_table(zvmc_revision rev) noexcept;
 
+/// Checks if the instruction has a single output depending only on its inputs
+/// so the analysis can fold it when the inputs are known.
+bool is_pure(uint8_t opcode) noexcept;
+
+/// Computes the net effect of the sequence of DUP/SWAP/POP instructions as done by the analysis.
+/// Returns std::nullopt if the sequence has other instructions or does not fit a StackShuffle.
+std::optional<StackShuffle> compute_stack_shuffle(bytes_view opcodes) noexcept;
+
 }  // namespace zvmone::advanced
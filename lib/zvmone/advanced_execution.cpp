@@ -4,10 +4,25 @@
 
 #include "advanced_execution.hpp"
 #include "advanced_analysis.hpp"
+#include "vm.hpp"
 #include <memory>
 
 namespace zvmone::advanced
 {
+namespace
+{
+zvmc_result make_result(AdvancedExecutionState& state) noexcept
+{
+    const auto gas_left =
+        (state.status == ZVMC_SUCCESS || state.status == ZVMC_REVERT) ? state.gas_left : 0;
+    const auto gas_refund = (state.status == ZVMC_SUCCESS) ? state.gas_refund : 0;
+
+    assert(state.output_size != 0 || state.output_offset == 0);
+    return state.memory.make_result(
+        state.status, gas_left, gas_refund, state.output_offset, state.output_size);
+}
+}  // namespace
+
 zvmc_result execute(AdvancedExecutionState& state, const AdvancedCodeAnalysis& analysis) noexcept
 {
     state.analysis.advanced = &analysis;  // Allow accessing the analysis by instructions.
@@ -16,22 +31,70 @@ zvmc_result execute(AdvancedExecutionState& state, const AdvancedCodeAnalysis& a
     while (instr != nullptr)
         instr = instr->fn(instr, state);
 
-    const auto gas_left =
-        (state.status == ZVMC_SUCCESS || state.status == ZVMC_REVERT) ? state.gas_left : 0;
-    const auto gas_refund = (state.status == ZVMC_SUCCESS) ? state.gas_refund : 0;
+    return make_result(state);
+}
 
-    assert(state.output_size != 0 || state.output_offset == 0);
-    return zvmc::make_result(state.status, gas_left, gas_refund,
-        state.memory.data() + state.output_offset, state.output_size);
+zvmc_result execute(
+    AdvancedExecutionState& state, const AdvancedCodeAnalysis& analysis, Tracer& tracer) noexcept
+{
+    assert(analysis.trace_info.size() == analysis.instrs.size());
+    state.analysis.advanced = &analysis;  // Allow accessing the analysis by instructions.
+
+    tracer.notify_execution_start(state.rev, *state.msg, state.original_code);
+
+    const auto* const first_instr = analysis.instrs.data();
+    const auto* instr = first_instr;
+    while (instr != nullptr)
+    {
+        const auto& info = analysis.trace_info[static_cast<size_t>(instr - first_instr)];
+        if (info.offset >= 0)  // Skip intrinsic instructions.
+        {
+            const auto offset = static_cast<uint32_t>(info.offset);
+
+            // The base gas cost of the basic block has been charged at the block beginning.
+            // Report the gas left as if the cost was charged per instruction.
+            // The JUMPDEST starts the basic block which cost has not been charged yet.
+            const auto gas = (state.original_code[offset] == OP_JUMPDEST) ?
+                                 state.gas_left :
+                                 state.gas_left + state.current_block_cost - info.block_gas_cost;
+            tracer.notify_instruction_start(
+                offset, state.stack.top_item, state.stack.size(), gas, state);
+        }
+        instr = instr->fn(instr, state);
+    }
+
+    const auto result = make_result(state);
+    tracer.notify_execution_end(result);
+    return result;
 }
 
-zvmc_result execute(zvmc_vm* /*unused*/, const zvmc_host_interface* host, zvmc_host_context* ctx,
+zvmc_result execute(zvmc_vm* c_vm, const zvmc_host_interface* host, zvmc_host_context* ctx,
     zvmc_revision rev, const zvmc_message* msg, const uint8_t* code, size_t code_size) noexcept
 {
-    AdvancedCodeAnalysis analysis;
+    auto& vm = *static_cast<VM*>(c_vm);
+    auto* tracer = vm.get_tracer();
     const bytes_view container = {code, code_size};
-    analysis = analyze(rev, container);
-    auto state = std::make_unique<AdvancedExecutionState>(*msg, rev, *host, ctx, container);
-    return execute(*state, analysis);
+    auto state = std::make_unique<AdvancedExecutionState>(
+        *msg, rev, *host, ctx, container, vm.shared_stack);
+    state->memory.set_backend(vm.memory_backend);
+    state->host_extension = vm.get_host_extension(host);
+    if (vm.storage_cache)
+        state->storage_cache.enable();
+
+    const auto result = [&]() noexcept {
+        // The cached analyses do not contain the tracing information.
+        if (auto* cache = vm.get_analysis_cache(); cache != nullptr && tracer == nullptr)
+            return execute(*state, *cache->get_advanced(rev, container));
+
+        AdvancedCodeAnalysis analysis;
+        analysis = analyze(rev, container, tracer != nullptr);
+        if (INTX_UNLIKELY(tracer != nullptr))
+            return execute(*state, analysis, *tracer);
+        return execute(*state, analysis);
+    }();
+
+    if (state->storage_cache.enabled())
+        vm.record_storage_cache_stats(state->storage_cache.stats());
+    return result;
 }
 }  // namespace zvmone::advanced
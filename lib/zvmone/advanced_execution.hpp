@@ -6,6 +6,11 @@
 #include <zvmc/utils.h>
 #include <zvmc/zvmc.h>
 
+namespace zvmone
+{
+class Tracer;
+}
+
 namespace zvmone::advanced
 {
 struct AdvancedExecutionState;
@@ -15,6 +20,14 @@ struct AdvancedCodeAnalysis;
 ZVMC_EXPORT zvmc_result execute(
     AdvancedExecutionState& state, const AdvancedCodeAnalysis& analysis) noexcept;
 
+/// Execute the already analyzed code using the provided execution state
+/// and report the execution progress to the tracer.
+///
+/// This is a separate interpreter loop so the non-tracing one is not affected.
+/// The analysis must contain the tracing information, see analyze().
+ZVMC_EXPORT zvmc_result execute(
+    AdvancedExecutionState& state, const AdvancedCodeAnalysis& analysis, Tracer& tracer) noexcept;
+
 /// ZVMC-compatible execute() function.
 zvmc_result execute(zvmc_vm* vm, const zvmc_host_interface* host, zvmc_host_context* ctx,
     zvmc_revision rev, const zvmc_message* msg, const uint8_t* code, size_t code_size) noexcept;
@@ -263,6 +263,56 @@ constexpr std::array<instruction_exec_fn, 256> instruction_implementations = [](
 }();
 }  // namespace
 
+const Instruction* opx_shuffle(const Instruction* instr, AdvancedExecutionState& state) noexcept
+{
+    const auto& shuffle =
+        state.analysis.advanced->stack_shuffles[static_cast<size_t>(instr->arg.number)];
+
+    // Copy the items first because the source and destination positions may overlap.
+    uint256 items[StackShuffle::max_size];
+    for (size_t i = 0; i < shuffle.size; ++i)
+        items[i] = state.stack[shuffle.src[i]];
+
+    state.stack.top_item += shuffle.height_change;
+    for (size_t i = 0; i < shuffle.size; ++i)
+        state.stack[static_cast<int>(i)] = items[i];
+
+    return instr + shuffle.num_instrs;
+}
+
+const Instruction* opx_push_constant(
+    const Instruction* instr, AdvancedExecutionState& state) noexcept
+{
+    const auto& constant =
+        state.analysis.advanced->folded_constants[static_cast<size_t>(instr->arg.number)];
+    state.stack.push(constant.value);
+    return instr + constant.num_instrs;
+}
+
+const Instruction* opx_div_pow2(const Instruction* instr, AdvancedExecutionState& state) noexcept
+{
+    state.stack[1] = state.stack[0] >> static_cast<uint64_t>(instr->arg.number);
+    state.stack.pop();
+    return ++instr;
+}
+
+const Instruction* opx_mod_pow2(const Instruction* instr, AdvancedExecutionState& state) noexcept
+{
+    const auto mask = (uint256{1} << static_cast<uint64_t>(instr->arg.number)) - 1;
+    state.stack[1] = state.stack[0] & mask;
+    state.stack.pop();
+    return ++instr;
+}
+
+const Instruction* opx_mul_pow2(const Instruction* instr, AdvancedExecutionState& state) noexcept
+{
+    const auto shift = static_cast<uint64_t>(instr->arg.number & 0xff);
+    const auto factor_pos = static_cast<int>(instr->arg.number >> 8);
+    state.stack[1] = state.stack[factor_pos] << shift;
+    state.stack.pop();
+    return ++instr;
+}
+
 ZVMC_EXPORT const OpTable& get_op_table(zvmc_revision rev) noexcept
 {
     static constexpr auto op_tables = []() noexcept {
@@ -0,0 +1,807 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "analysis_cache.hpp"
+#include "instructions_traits.hpp"
+#include "keccak.hpp"
+#include <intx/intx.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZVMONE_ANALYSIS_CACHE_MMAP 1
+#else
+#define ZVMONE_ANALYSIS_CACHE_MMAP 0
+#if defined(_WIN32)
+#include <process.h>
+#endif
+#endif
+
+namespace zvmone
+{
+namespace
+{
+using Hash = uint8_t[32];
+
+/// The header of the serialized analysis. The multi-byte fields are in the host byte order.
+struct Header
+{
+    uint8_t magic[4];
+    uint32_t version;
+    uint32_t rev;
+    uint32_t padding;
+    uint64_t code_size;
+    uint64_t payload_size;
+    uint8_t fingerprint[32];
+    uint8_t code_hash[32];
+    uint8_t payload_hash[32];
+};
+static_assert(sizeof(Header) == 128);
+static_assert(std::is_trivially_copyable_v<Header>);
+
+constexpr uint8_t header_magic[4] = {'Z', 'V', 'M', 'A'};
+
+/// The instruction differing from the analysis without the optimizations.
+struct Patch
+{
+    uint32_t index;
+    uint8_t intrinsic;  ///< The index in the intrinsic_fns or 0 if only the argument differs.
+    uint8_t padding[3];
+    uint64_t arg;
+};
+static_assert(sizeof(Patch) == 16);
+
+/// The Advanced intrinsic instructions without opcodes. The index 0 means "no intrinsic".
+constexpr advanced::instruction_exec_fn intrinsic_fns[] = {nullptr, advanced::opx_shuffle,
+    advanced::opx_push_constant, advanced::opx_div_pow2, advanced::opx_mod_pow2,
+    advanced::opx_mul_pow2};
+constexpr auto num_intrinsics = std::size(intrinsic_fns);
+
+/// Computes the fast non-cryptographic hash of the code for the in-memory index.
+/// This is a word-wise variant of FNV-1a.
+uint64_t checksum(bytes_view data) noexcept
+{
+    constexpr uint64_t prime = 0x100000001b3;
+    uint64_t h = 0xcbf29ce484222325;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        std::memcpy(&w, &data[i], sizeof(w));
+        h = (h ^ w) * prime;
+        h ^= h >> 32;
+    }
+    for (; i < data.size(); ++i)
+        h = (h ^ data[i]) * prime;
+    return h;
+}
+
+/// Appends the trivially copyable values to the output buffer.
+class Writer
+{
+    bytes& m_out;
+
+public:
+    explicit Writer(bytes& out) noexcept : m_out{out} {}
+
+    template <typename T>
+    void put(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_out.append(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+    }
+
+    void put_bytes(bytes_view data) { m_out.append(data); }
+};
+
+/// Reads the trivially copyable values from the input buffer with bounds checking.
+class Reader
+{
+    bytes_view m_in;
+
+public:
+    explicit Reader(bytes_view in) noexcept : m_in{in} {}
+
+    template <typename T>
+    [[nodiscard]] bool get(T& value) noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (m_in.size() < sizeof(value))
+            return false;
+        std::memcpy(&value, m_in.data(), sizeof(value));
+        m_in.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    [[nodiscard]] bool get_bytes(bytes_view& data, size_t size) noexcept
+    {
+        if (m_in.size() < size)
+            return false;
+        data = m_in.substr(0, size);
+        m_in.remove_prefix(size);
+        return true;
+    }
+
+    /// Reads the count of elements of the given size making sure they can fit in the input.
+    [[nodiscard]] bool get_count(size_t& count, size_t element_size) noexcept
+    {
+        uint64_t n = 0;
+        if (!get(n) || n > m_in.size() / element_size)
+            return false;
+        count = static_cast<size_t>(n);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return m_in.empty(); }
+};
+
+void keccak256(Hash& out, bytes_view data) noexcept
+{
+    const auto h = zvmone::keccak256(data.data(), data.size());
+    std::memcpy(out, h.bytes, sizeof(out));
+}
+
+/// Returns the fingerprint of everything the analysis depends on beside the code:
+/// the format version, the zvmone version, the revision's op table
+/// and the EXP cost charged for the folded constants.
+const zvmc::bytes32& get_fingerprint(zvmc_revision rev) noexcept
+{
+    static const auto fingerprints = []() noexcept {
+        std::array<zvmc::bytes32, ZVMC_MAX_REVISION + 1> out{};
+        for (size_t r = 0; r < out.size(); ++r)
+        {
+            bytes data;
+            Writer w{data};
+            w.put(analysis_format_version);
+            w.put(static_cast<uint32_t>(r));
+            w.put(int32_t{instr::exp_byte_cost});
+            for (const auto& entry : advanced::get_op_table(static_cast<zvmc_revision>(r)))
+            {
+                w.put(entry.gas_cost);
+                w.put(entry.stack_req);
+                w.put(entry.stack_change);
+            }
+            const std::string_view version{PROJECT_VERSION};
+            w.put_bytes({reinterpret_cast<const uint8_t*>(version.data()), version.size()});
+            out[r] = zvmone::keccak256(data.data(), data.size());
+        }
+        return out;
+    }();
+    return fingerprints[static_cast<size_t>(rev)];
+}
+
+bytes serialize(zvmc_revision rev, bytes_view code, const Hash& code_hash, bytes_view payload)
+{
+    Header header{};
+    std::memcpy(header.magic, header_magic, sizeof(header.magic));
+    header.version = analysis_format_version;
+    header.rev = static_cast<uint32_t>(rev);
+    header.code_size = code.size();
+    header.payload_size = payload.size();
+    std::memcpy(header.fingerprint, get_fingerprint(rev).bytes, sizeof(header.fingerprint));
+    std::memcpy(header.code_hash, code_hash, sizeof(header.code_hash));
+    keccak256(header.payload_hash, payload);
+
+    bytes out;
+    out.reserve(sizeof(header) + payload.size());
+    Writer w{out};
+    w.put(header);
+    w.put_bytes(payload);
+    return out;
+}
+
+/// Validates the header and the payload hash and returns the payload.
+std::optional<bytes_view> get_payload(
+    zvmc_revision rev, bytes_view code, const Hash& code_hash, bytes_view data) noexcept
+{
+    Reader r{data};
+    Header header;
+    if (!r.get(header))
+        return {};
+    if (std::memcmp(header.magic, header_magic, sizeof(header.magic)) != 0 ||
+        header.version != analysis_format_version || header.rev != static_cast<uint32_t>(rev) ||
+        header.code_size != code.size() ||
+        std::memcmp(header.fingerprint, get_fingerprint(rev).bytes, sizeof(header.fingerprint)) !=
+            0 ||
+        std::memcmp(header.code_hash, code_hash, sizeof(header.code_hash)) != 0)
+        return {};
+
+    bytes_view payload;
+    Hash payload_hash;
+    if (header.payload_size != data.size() - sizeof(header) ||
+        !r.get_bytes(payload, static_cast<size_t>(header.payload_size)))
+        return {};
+    keccak256(payload_hash, payload);
+    if (std::memcmp(header.payload_hash, payload_hash, sizeof(payload_hash)) != 0)
+        return {};
+    return payload;
+}
+
+bytes serialize_advanced(zvmc_revision rev, bytes_view code, const Hash& code_hash,
+    const advanced::AdvancedCodeAnalysis& analysis)
+{
+    const auto push_full_fn = advanced::get_op_table(rev)[OP_PUSH32].fn;
+    const auto base = advanced::analyze(rev, code, true);
+    if (base.instrs.size() != analysis.instrs.size())
+        return {};  // The analysis has not been created for this code.
+
+    bytes patches;
+    Writer pw{patches};
+    size_t num_patches = 0;
+    for (size_t i = 0; i < analysis.instrs.size(); ++i)
+    {
+        const auto& instr = analysis.instrs[i];
+        const auto& base_instr = base.instrs[i];
+        Patch patch{};
+        patch.index = static_cast<uint32_t>(i);
+        const auto intrinsic = std::find(std::begin(intrinsic_fns) + 1, std::end(intrinsic_fns),
+            instr.fn);
+        if (intrinsic != std::end(intrinsic_fns))
+            patch.intrinsic = static_cast<uint8_t>(intrinsic - std::begin(intrinsic_fns));
+        else if (instr.fn != base_instr.fn)
+            return {};  // The analysis has not been created for this revision.
+        else if (instr.fn == push_full_fn ||
+                 std::memcmp(&instr.arg, &base_instr.arg, sizeof(instr.arg)) == 0)
+            continue;
+        std::memcpy(&patch.arg, &instr.arg, sizeof(patch.arg));
+        pw.put(patch);
+        ++num_patches;
+    }
+
+    bytes payload;
+    Writer w{payload};
+    w.put(uint64_t{analysis.instrs.size()});
+    w.put(uint64_t{num_patches});
+    w.put(uint64_t{analysis.stack_shuffles.size()});
+    w.put(uint64_t{analysis.folded_constants.size()});
+    w.put_bytes(patches);
+    for (const auto& shuffle : analysis.stack_shuffles)
+        w.put(shuffle);
+    for (const auto& constant : analysis.folded_constants)
+    {
+        w.put(constant.value);
+        w.put(constant.num_instrs);
+    }
+    return serialize(rev, code, code_hash, payload);
+}
+
+/// Checks if the instruction pushes the value or has a single output computed from its inputs
+/// so it can be a part of the folded constant range.
+bool is_foldable(uint8_t opcode) noexcept
+{
+    return opcode == OP_PUSH0 || (opcode >= OP_PUSH1 && opcode <= OP_PUSH32) ||
+           (opcode >= OP_DUP1 && opcode <= OP_DUP16) || advanced::is_pure(opcode);
+}
+
+/// Checks if the instruction argument is the block gas cost at the instruction.
+bool has_gas_cost_arg(uint8_t opcode) noexcept
+{
+    switch (opcode)
+    {
+    case OP_GAS:
+    case OP_CALL:
+    case OP_DELEGATECALL:
+    case OP_STATICCALL:
+    case OP_CREATE:
+    case OP_CREATE2:
+    case OP_SSTORE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Applies the stored patches to the analysis without the optimizations and verifies them
+/// against the code.
+///
+/// The instruction replaced by an intrinsic must stay equivalent to the original ones for the
+/// stack so the re-derived block stack requirements remain valid. The block gas costs and the
+/// gas cost arguments may only exceed the re-derived ones by the cost of the folded EXPs.
+class PatchVerifier
+{
+    const advanced::OpTable& m_op_table;
+    bytes_view m_code;
+    advanced::AdvancedCodeAnalysis& m_analysis;
+    const std::vector<advanced::InstructionTraceInfo>& m_trace_info;
+
+    /// The index of the instruction holding the current block information.
+    size_t m_block_index = 0;
+
+    /// The re-derived information of the current block.
+    advanced::BlockInfo m_block{};
+
+    /// The maximum cost of the folded EXPs in the current block so far.
+    int64_t m_max_exp_cost = 0;
+
+public:
+    PatchVerifier(const advanced::OpTable& op_table, bytes_view code,
+        advanced::AdvancedCodeAnalysis& analysis,
+        const std::vector<advanced::InstructionTraceInfo>& trace_info) noexcept
+      : m_op_table{op_table}, m_code{code}, m_analysis{analysis}, m_trace_info{trace_info}
+    {}
+
+    /// Applies the patches sorted by the instruction index.
+    [[nodiscard]] bool apply(const std::vector<Patch>& patches) noexcept
+    {
+        const auto num_instrs = m_analysis.instrs.size();
+        auto patch = patches.begin();
+        for (size_t i = 0; i < num_instrs; ++i)
+        {
+            const auto opcode = get_opcode(i);
+            // The JUMPDEST starts the block. The JUMPI holds the information of the next block.
+            if (i == 0 || opcode == OP_JUMPDEST || opcode == OP_JUMPI)
+            {
+                if (i != 0 && !close_block())
+                    return false;
+                m_block_index = i;
+                m_block = m_analysis.instrs[i].arg.block;
+                m_max_exp_cost = 0;
+            }
+
+            if (patch == patches.end() || patch->index != i)
+                continue;
+            if (!apply(*patch, opcode))
+                return false;
+            ++patch;
+        }
+        // The patches must be sorted and reference existing instructions.
+        return patch == patches.end() && close_block();
+    }
+
+private:
+    /// Returns the opcode of the instruction or -1 for the intrinsic instructions.
+    [[nodiscard]] int get_opcode(size_t index) const noexcept
+    {
+        const auto offset = m_trace_info[index].offset;
+        return offset >= 0 ? int{m_code[static_cast<size_t>(offset)]} : -1;
+    }
+
+    /// Checks the stored block information against the re-derived one.
+    [[nodiscard]] bool close_block() const noexcept
+    {
+        const auto& block = m_analysis.instrs[m_block_index].arg.block;
+        return block.stack_req == m_block.stack_req &&
+               block.stack_max_growth == m_block.stack_max_growth &&
+               block.gas_cost >= m_block.gas_cost &&
+               block.gas_cost - m_block.gas_cost <= m_max_exp_cost;
+    }
+
+    /// Checks if the instructions replaced by the intrinsic instruction exist
+    /// and are followed by an instruction.
+    [[nodiscard]] bool has_range(size_t index, int32_t num_instrs) const noexcept
+    {
+        return num_instrs >= 1 &&
+               static_cast<size_t>(num_instrs) < m_analysis.instrs.size() - index;
+    }
+
+    [[nodiscard]] bool apply(const Patch& patch, int opcode) noexcept
+    {
+        auto& instr = m_analysis.instrs[patch.index];
+        advanced::InstructionArgument arg;
+        arg.small_push_value = patch.arg;
+        const auto k = arg.number;
+
+        switch (patch.intrinsic)
+        {
+        case 0:
+            if (patch.index == m_block_index)
+            {
+                // The block information is checked when the block is closed.
+            }
+            else if (opcode >= 0 && has_gas_cost_arg(static_cast<uint8_t>(opcode)))
+            {
+                if (k < instr.arg.number || k - instr.arg.number > m_max_exp_cost)
+                    return false;
+            }
+            else
+                return false;
+            instr.arg = arg;
+            return true;
+
+        case 1:  // opx_shuffle
+        {
+            if (static_cast<uint64_t>(k) >= m_analysis.stack_shuffles.size())
+                return false;
+            const auto& shuffle = m_analysis.stack_shuffles[static_cast<size_t>(k)];
+            if (!has_range(patch.index, shuffle.num_instrs))
+                return false;
+
+            // The single byte DUP/SWAP/POP instructions are consecutive in the code.
+            const auto n = static_cast<size_t>(shuffle.num_instrs);
+            const auto begin = m_trace_info[patch.index].offset;
+            const auto last = m_trace_info[patch.index + n - 1].offset;
+            if (begin < 0 || last != begin + shuffle.num_instrs - 1)
+                return false;
+            const auto opcodes = m_code.substr(static_cast<size_t>(begin), n);
+            if (advanced::compute_stack_shuffle(opcodes) != shuffle)
+                return false;
+            break;
+        }
+
+        case 2:  // opx_push_constant
+        {
+            if (static_cast<uint64_t>(k) >= m_analysis.folded_constants.size())
+                return false;
+            const auto& constant = m_analysis.folded_constants[static_cast<size_t>(k)];
+            if (!has_range(patch.index, constant.num_instrs))
+                return false;
+
+            // The range must only push the single value. The JUMPDEST and JUMPI are not
+            // foldable so the range is in a single block.
+            int stack_change = 0;
+            int num_exps = 0;
+            for (size_t j = 0; j < static_cast<size_t>(constant.num_instrs); ++j)
+            {
+                const auto op = get_opcode(patch.index + j);
+                if (op < 0 || !is_foldable(static_cast<uint8_t>(op)))
+                    return false;
+                stack_change += m_op_table[static_cast<size_t>(op)].stack_change;
+                num_exps += (op == OP_EXP);
+            }
+            if (stack_change != 1)
+                return false;
+            m_max_exp_cost += int64_t{num_exps} * instr::exp_byte_cost * 32;
+            break;
+        }
+
+        case 3:  // opx_div_pow2
+        case 4:  // opx_mod_pow2
+        case 5:  // opx_mul_pow2
+        {
+            // The shift and the position of the other MUL factor (the stack top or the next item)
+            // are encoded in the argument.
+            const auto expected_opcode =
+                patch.intrinsic == 3 ? OP_DIV : patch.intrinsic == 4 ? OP_MOD : OP_MUL;
+            const auto max_arg = patch.intrinsic == 5 ? 511 : 255;
+            if (opcode != expected_opcode || k < 0 || k > max_arg)
+                return false;
+            break;
+        }
+
+        default:
+            return false;
+        }
+
+        instr.fn = intrinsic_fns[patch.intrinsic];
+        instr.arg = arg;
+        return true;
+    }
+};
+
+std::optional<advanced::AdvancedCodeAnalysis> deserialize_advanced(
+    zvmc_revision rev, bytes_view code, const Hash& code_hash, bytes_view data) noexcept
+{
+    const auto payload = get_payload(rev, code, code_hash, data);
+    if (!payload)
+        return {};
+
+    Reader r{*payload};
+    uint64_t num_instrs = 0;
+    size_t num_patches = 0;
+    size_t num_shuffles = 0;
+    size_t num_constants = 0;
+    if (!r.get(num_instrs) || !r.get_count(num_patches, sizeof(Patch)) ||
+        !r.get_count(num_shuffles, sizeof(advanced::StackShuffle)) ||
+        !r.get_count(num_constants, sizeof(intx::uint256) + sizeof(int32_t)))
+        return {};
+
+    std::vector<Patch> patches(num_patches);
+    for (auto& patch : patches)
+    {
+        if (!r.get(patch))
+            return {};
+    }
+
+    // The instructions, the push values, the JUMPDESTs and the jump table are re-derived
+    // from the code. The trace information provides the code offsets of the instructions.
+    auto analysis = advanced::analyze(rev, code, true);
+    const auto trace_info = std::exchange(analysis.trace_info, {});
+    if (analysis.instrs.size() != num_instrs)
+        return {};
+
+    analysis.stack_shuffles.resize(num_shuffles);
+    for (auto& shuffle : analysis.stack_shuffles)
+    {
+        if (!r.get(shuffle))
+            return {};
+    }
+    analysis.folded_constants.resize(num_constants);
+    for (auto& constant : analysis.folded_constants)
+    {
+        if (!r.get(constant.value) || !r.get(constant.num_instrs))
+            return {};
+    }
+    if (!r.empty())
+        return {};
+
+    PatchVerifier verifier{advanced::get_op_table(rev), code, analysis, trace_info};
+    if (!verifier.apply(patches))
+        return {};
+    return analysis;
+}
+
+/// The read-only view of the whole file. Empty if the file cannot be read.
+/// The file is mapped in memory where supported and read into the buffer otherwise.
+class FileView
+{
+#if ZVMONE_ANALYSIS_CACHE_MMAP
+    void* m_mapping = nullptr;
+#else
+    bytes m_buffer;
+#endif
+    bytes_view m_data;
+
+public:
+    explicit FileView(const std::string& path) noexcept
+    {
+#if ZVMONE_ANALYSIS_CACHE_MMAP
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st = {};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            const auto size = static_cast<size_t>(st.st_size);
+            if (auto* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0); p != MAP_FAILED)
+            {
+                m_mapping = p;
+                m_data = {static_cast<const uint8_t*>(p), size};
+            }
+        }
+        ::close(fd);
+#else
+        auto* f = std::fopen(path.c_str(), "rb");
+        if (f == nullptr)
+            return;
+
+        uint8_t buf[4096];
+        size_t n = 0;
+        while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+            m_buffer.append(buf, n);
+        std::fclose(f);
+        m_data = m_buffer;
+#endif
+    }
+
+    ~FileView()
+    {
+#if ZVMONE_ANALYSIS_CACHE_MMAP
+        if (m_mapping != nullptr)
+            ::munmap(m_mapping, m_data.size());
+#endif
+    }
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    [[nodiscard]] bytes_view data() const noexcept { return m_data; }
+};
+
+/// Returns the approximate memory size of the Advanced analysis.
+size_t memory_size(const advanced::AdvancedCodeAnalysis& analysis) noexcept
+{
+    return sizeof(analysis) + analysis.instrs.size() * sizeof(advanced::Instruction) +
+           analysis.push_values.size() * sizeof(intx::uint256) +
+           analysis.jumpdest_offsets.size() * sizeof(int32_t) +
+           analysis.jumpdest_targets.size() * sizeof(int32_t) +
+           analysis.jump_table.size() * sizeof(uint16_t) +
+           analysis.stack_shuffles.size() * sizeof(advanced::StackShuffle) +
+           analysis.folded_constants.size() * sizeof(advanced::FoldedConstant);
+}
+
+/// Returns the id of the current process.
+uint64_t get_process_id() noexcept
+{
+#if ZVMONE_ANALYSIS_CACHE_MMAP
+    return static_cast<uint64_t>(::getpid());
+#elif defined(_WIN32)
+    return static_cast<uint64_t>(::_getpid());
+#else
+    return 0;
+#endif
+}
+
+/// Writes the file atomically by renaming the fully written temporary file.
+/// The temporary file name must be unique among all processes sharing the directory.
+void store_file(const std::string& path, const std::string& tmp_path, bytes_view data) noexcept
+{
+    auto* f = std::fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr)
+        return;
+    const auto ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (std::fclose(f) != 0 || !ok)
+    {
+        std::remove(tmp_path.c_str());
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec)
+        std::filesystem::remove(tmp_path, ec);
+}
+}  // namespace
+
+bytes serialize(zvmc_revision rev, bytes_view code, const advanced::AdvancedCodeAnalysis& analysis)
+{
+    Hash code_hash;
+    keccak256(code_hash, code);
+    return serialize_advanced(rev, code, code_hash, analysis);
+}
+
+std::optional<advanced::AdvancedCodeAnalysis> deserialize_advanced(
+    zvmc_revision rev, bytes_view code, bytes_view data) noexcept
+{
+    Hash code_hash;
+    keccak256(code_hash, code);
+    return deserialize_advanced(rev, code, code_hash, data);
+}
+
+
+size_t AnalysisCache::KeyHash::operator()(const Key& key) const noexcept
+{
+    auto h = key.code_hash ^ (uint64_t{key.code_size} << 8);
+    h ^= static_cast<uint64_t>(key.rev);
+    return static_cast<size_t>(h * 0x9e3779b97f4a7c15);
+}
+
+AnalysisCache::AnalysisCache(std::string dir, size_t max_memory_size)
+  : m_dir{std::move(dir)}, m_max_memory_size{max_memory_size}, m_random{std::random_device{}()}
+{
+    std::error_code ec;
+    std::filesystem::create_directories(m_dir, ec);
+    m_writer = std::thread{&AnalysisCache::write_loop, this};
+}
+
+std::unique_ptr<AnalysisCache> AnalysisCache::create(
+    std::string dir, size_t max_memory_size) noexcept
+{
+    // This file is compiled with exceptions enabled for this purpose.
+    try
+    {
+        return std::make_unique<AnalysisCache>(std::move(dir), max_memory_size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+AnalysisCache::~AnalysisCache()
+{
+    {
+        const std::lock_guard lock{m_write_mutex};
+        m_stop = true;
+    }
+    m_write_cv.notify_one();
+    m_writer.join();
+}
+
+std::string AnalysisCache::get_path(const uint8_t (&code_hash)[32], zvmc_revision rev) const
+{
+    static constexpr auto hex_digits = "0123456789abcdef";
+    std::string name;
+    name.reserve(2 * sizeof(code_hash));
+    for (const auto b : code_hash)
+    {
+        name += hex_digits[b >> 4];
+        name += hex_digits[b & 0xf];
+    }
+    name += '-' + std::to_string(static_cast<int>(rev)) + ".advanced";
+    return (std::filesystem::path{m_dir} / name).string();
+}
+
+size_t AnalysisCache::memory_size() noexcept
+{
+    const std::lock_guard lock{m_mutex};
+    return m_memory_size;
+}
+
+std::shared_ptr<const advanced::AdvancedCodeAnalysis> AnalysisCache::find(
+    const Key& key, bytes_view code)
+{
+    const std::lock_guard lock{m_mutex};
+    const auto it = m_index.find(key);
+    if (it == m_index.end() || it->second->code != code)
+        return nullptr;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->analysis;
+}
+
+std::shared_ptr<const advanced::AdvancedCodeAnalysis> AnalysisCache::insert(const Key& key,
+    bytes_view code, std::shared_ptr<const advanced::AdvancedCodeAnalysis> analysis, size_t size)
+{
+    const auto entry_size = size + code.size();
+
+    const std::lock_guard lock{m_mutex};
+    if (const auto it = m_index.find(key); it != m_index.end())
+    {
+        // In case of a race the first inserted analysis wins.
+        // In case of the hash collision the new code replaces the old one.
+        if (it->second->code == code)
+            return it->second->analysis;
+        m_memory_size -= it->second->memory_size;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.push_front({key, bytes{code}, std::move(analysis), entry_size});
+    m_index.emplace(key, m_entries.begin());
+    m_memory_size += entry_size;
+
+    // Evict the least recently used entries, but always keep the new one.
+    while (m_memory_size > m_max_memory_size && m_entries.size() > 1)
+    {
+        const auto& lru = m_entries.back();
+        m_memory_size -= lru.memory_size;
+        m_index.erase(lru.key);
+        m_entries.pop_back();
+    }
+    return m_entries.front().analysis;
+}
+
+std::shared_ptr<const advanced::AdvancedCodeAnalysis> AnalysisCache::get_advanced(
+    zvmc_revision rev, bytes_view code)
+{
+    const Key key{checksum(code), code.size(), rev};
+    if (auto cached = find(key, code))
+        return cached;
+
+    // Load or analyze outside of the lock. The code hash is only needed for the file name.
+    Hash code_hash;
+    keccak256(code_hash, code);
+    auto path = get_path(code_hash, rev);
+    auto loaded = deserialize_advanced(rev, code, code_hash, FileView{path}.data());
+    const auto is_new = !loaded.has_value();
+    const auto analysis = std::make_shared<const advanced::AdvancedCodeAnalysis>(
+        is_new ? advanced::analyze(rev, code) : std::move(*loaded));
+    if (is_new)
+        schedule_write({std::move(path), rev, bytes{code}, analysis});
+
+    return insert(key, code, analysis, zvmone::memory_size(*analysis));
+}
+
+void AnalysisCache::schedule_write(PendingWrite write)
+{
+    {
+        const std::lock_guard lock{m_write_mutex};
+        m_write_queue.emplace_back(std::move(write));
+    }
+    m_write_cv.notify_one();
+}
+
+void AnalysisCache::write_loop() noexcept
+{
+    std::unique_lock lock{m_write_mutex};
+    while (true)
+    {
+        m_write_cv.wait(lock, [this] { return m_stop || !m_write_queue.empty(); });
+        if (m_write_queue.empty())
+            return;  // Stopped and all pending writes flushed.
+
+        const auto write = std::move(m_write_queue.front());
+        m_write_queue.pop_front();
+        lock.unlock();
+        // The serialization re-derives the unoptimized analysis so it is done here
+        // instead of delaying the execution.
+        if (const auto data = serialize(write.rev, write.code, *write.analysis); !data.empty())
+        {
+            const auto tmp_path = write.path + '.' + std::to_string(get_process_id()) + '.' +
+                                  std::to_string(m_random()) + ".tmp";
+            store_file(write.path, tmp_path, data);
+        }
+        lock.lock();
+    }
+}
+}  // namespace zvmone
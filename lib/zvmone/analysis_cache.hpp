@@ -0,0 +1,151 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include "advanced_analysis.hpp"
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace zvmone
+{
+/// The version of the serialized code analysis format.
+/// Must be bumped on any change of the format or of the analysis itself. The files are also
+/// invalidated by a change of the zvmone version or of the op table (see serialize()).
+inline constexpr uint32_t analysis_format_version = 5;
+
+/// Serializes the Advanced code analysis of the given code.
+///
+/// Only the difference from the analysis without the optimizations merging instructions
+/// is stored: the intrinsic instructions with the stack shuffles and the folded constants
+/// they reference and the block costs including the folded EXP costs. The rest is re-derived
+/// from the code when loading. The header contains the code hash, the payload hash and the
+/// fingerprint of the zvmone version and the revision's op table.
+/// The tracing information is not serialized.
+/// Returns empty bytes if the analysis has instructions not present in the revision's op table.
+ZVMC_EXPORT bytes serialize(
+    zvmc_revision rev, bytes_view code, const advanced::AdvancedCodeAnalysis& analysis);
+
+/// Deserializes the Advanced code analysis.
+///
+/// The stored optimizations are verified against the code: the stack shuffles are recomputed,
+/// the folded ranges must only contain pure instructions pushing a single value, the shifts
+/// must replace the matching arithmetic instructions and the block stack requirements must be
+/// equal to the re-derived ones. The folded constant values are not recomputed.
+/// Returns std::nullopt if the data is invalid, corrupted or has been created for other code,
+/// other zvmone version or other op table.
+ZVMC_EXPORT std::optional<advanced::AdvancedCodeAnalysis> deserialize_advanced(
+    zvmc_revision rev, bytes_view code, bytes_view data) noexcept;
+
+
+/// The cache of the Advanced code analyses persisted in a directory.
+///
+/// The Baseline analyses are not cached because loading them is not faster than
+/// the baseline::analyze() which is a single pass over the code.
+///
+/// The analyses are kept in memory up to the given total size with the least recently used
+/// ones evicted first. The in-memory index uses a fast non-cryptographic hash of the code
+/// verified against the stored copy of the code. On the in-memory miss, the analysis is loaded
+/// (mmap) from the cache directory where the files are named by the code hash (Keccak-256).
+/// New analyses are serialized and written to the directory by a background thread.
+///
+/// The directory must only be writable by the trusted processes: the loaded analyses are
+/// verified to be memory-safe to execute for the code, but the values of the folded constants
+/// are taken from the files.
+class ZVMC_EXPORT AnalysisCache
+{
+    struct Key
+    {
+        uint64_t code_hash;
+        size_t code_size;
+        zvmc_revision rev;
+
+        friend bool operator==(const Key&, const Key&) = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct Entry
+    {
+        Key key;
+        bytes code;  ///< The copy of the code to verify the fast hash match.
+        std::shared_ptr<const advanced::AdvancedCodeAnalysis> analysis;
+        size_t memory_size;
+    };
+
+    struct PendingWrite
+    {
+        std::string path;
+        zvmc_revision rev;
+        bytes code;
+        std::shared_ptr<const advanced::AdvancedCodeAnalysis> analysis;
+    };
+
+    std::string m_dir;
+    size_t m_max_memory_size;
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;  ///< The entries from the most recently used.
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+    size_t m_memory_size = 0;
+
+    std::mutex m_write_mutex;
+    std::condition_variable m_write_cv;
+    std::deque<PendingWrite> m_write_queue;
+    bool m_stop = false;
+    std::mt19937_64 m_random;  ///< The source of the temporary file names. Used by the writer.
+    std::thread m_writer;
+
+public:
+    /// The default limit of the total size of the analyses kept in memory.
+    static constexpr size_t default_max_memory_size = size_t{256} * 1024 * 1024;
+
+    /// Creates the cache in the given directory. The directory is created if needed.
+    explicit AnalysisCache(std::string dir, size_t max_memory_size = default_max_memory_size);
+
+    /// Creates the cache like the constructor but returns null instead of throwing
+    /// (e.g. when the background writer thread cannot be started).
+    static std::unique_ptr<AnalysisCache> create(
+        std::string dir, size_t max_memory_size = default_max_memory_size) noexcept;
+
+    /// Stops the background writer after flushing all pending writes.
+    ~AnalysisCache();
+
+    AnalysisCache(const AnalysisCache&) = delete;
+    AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+    /// Returns the Advanced analysis of the code.
+    /// The analysis stays valid after being evicted from the cache as long as it is referenced.
+    std::shared_ptr<const advanced::AdvancedCodeAnalysis> get_advanced(
+        zvmc_revision rev, bytes_view code);
+
+    /// Returns the total size of the analyses kept in memory.
+    [[nodiscard]] size_t memory_size() noexcept;
+
+private:
+    /// Returns the cached analysis and marks it as the most recently used or null if not found.
+    std::shared_ptr<const advanced::AdvancedCodeAnalysis> find(const Key& key, bytes_view code);
+
+    /// Inserts the analysis unless already present and evicts the least recently used ones
+    /// above the memory limit. Returns the cached analysis.
+    std::shared_ptr<const advanced::AdvancedCodeAnalysis> insert(const Key& key, bytes_view code,
+        std::shared_ptr<const advanced::AdvancedCodeAnalysis> analysis, size_t size);
+
+    [[nodiscard]] std::string get_path(const uint8_t (&code_hash)[32], zvmc_revision rev) const;
+
+    void schedule_write(PendingWrite write);
+
+    void write_loop() noexcept;
+};
+}  // namespace zvmone
@@ -0,0 +1,228 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <intx/intx.hpp>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ZVMONE_KERNELS_X86_64 1
+#endif
+
+/// The 256-bit arithmetic kernels using the x86-64 instructions.
+///
+/// The kernels are selected at compile time by the instruction sets enabled for the target,
+/// i.e. by the ZVMONE_X86_64_ARCH_LEVEL (x86-64-v3 enables AVX2, x86-64-v4 enables AVX-512).
+/// The support of the level is checked at startup (cpu_check.cpp).
+/// Otherwise, the portable intx implementation is used.
+///
+/// The AVX2 and AVX-512 variants are defined in the detail namespace for any x86-64 level
+/// (with the target attribute) so they can be tested wherever the CPU supports them
+/// (see is_supported()).
+///
+/// Only the kernels faster than intx are provided (see zvmone-bench-internal).
+/// The MULX/ADCX/ADOX multiplication and the funnel shifts measured slower than
+/// the intx implementations.
+namespace zvmone::kernels
+{
+using intx::uint256;
+
+/// The names of the instruction sets used by the kernels. For the benchmark reports.
+inline constexpr const char* isa_name =
+#if defined(__AVX512VL__) && defined(__AVX512BW__)
+    "avx512"
+#elif defined(__AVX2__)
+    "avx2"
+#elif defined(ZVMONE_KERNELS_X86_64)
+    "x86_64"
+#else
+    "portable"
+#endif
+    ;
+
+/// The instruction set extensions used by the kernel variants.
+enum class Isa
+{
+    avx2,
+    avx512,  ///< AVX-512 VL and BW, and BMI2.
+};
+
+/// Checks if the kernel variants using the instruction set extension are supported by the CPU.
+inline bool is_supported([[maybe_unused]] Isa isa) noexcept
+{
+#if ZVMONE_KERNELS_X86_64
+    switch (isa)
+    {
+    case Isa::avx2:
+        return __builtin_cpu_supports("avx2");
+    case Isa::avx512:
+        return __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("bmi2");
+    }
+#endif
+    return false;
+}
+
+#if ZVMONE_KERNELS_X86_64
+namespace detail
+{
+[[gnu::target("avx2")]] inline __m256i load(const uint256& x) noexcept
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x));
+}
+
+[[gnu::target("avx2")]] inline void store(uint256& x, __m256i v) noexcept
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&x), v);
+}
+
+/// Adds with carry (ADC).
+inline unsigned char addc(unsigned char c, uint64_t x, uint64_t y, uint64_t& r) noexcept
+{
+    unsigned long long s;  // NOLINT(google-runtime-int)
+    c = _addcarry_u64(c, x, y, &s);
+    r = s;
+    return c;
+}
+
+/// Subtracts with borrow (SBB).
+inline unsigned char subb(unsigned char b, uint64_t x, uint64_t y, uint64_t& r) noexcept
+{
+    unsigned long long d;  // NOLINT(google-runtime-int)
+    b = _subborrow_u64(b, x, y, &d);
+    r = d;
+    return b;
+}
+
+/// Computes x < y with AVX-512.
+[[gnu::target("avx2,avx512f,avx512vl")]] inline bool lt_avx512(
+    const uint256& x, const uint256& y) noexcept
+{
+    // The most significant differing word decides. The masks are disjoint so comparing them
+    // as numbers finds the higher of the most significant bits.
+    const auto vx = load(x);
+    const auto vy = load(y);
+    return _mm256_cmplt_epu64_mask(vx, vy) > _mm256_cmpgt_epu64_mask(vx, vy);
+}
+
+/// Computes x == y with AVX2.
+[[gnu::target("avx2")]] inline bool eq_avx2(const uint256& x, const uint256& y) noexcept
+{
+    const auto d = _mm256_xor_si256(load(x), load(y));
+    return _mm256_testz_si256(d, d) != 0;
+}
+
+/// Computes x == 0 with AVX2.
+[[gnu::target("avx2")]] inline bool is_zero_avx2(const uint256& x) noexcept
+{
+    const auto v = load(x);
+    return _mm256_testz_si256(v, v) != 0;
+}
+
+/// Sign-extends x from the byte of the given index (less than 31) with AVX-512.
+[[gnu::target("avx2,avx512f,avx512vl,avx512bw,bmi2")]] inline void signextend_avx512(
+    uint256& x, unsigned sign_byte_index) noexcept
+{
+    // Blend the bytes above the sign byte with the sign byte's sign.
+    const auto sign_word = x[sign_byte_index / 8];
+    const auto sign_byte = static_cast<int8_t>(sign_word >> (sign_byte_index % 8 * 8));
+    const auto fill = _mm256_set1_epi8(static_cast<char>(sign_byte >> 7));
+    const auto keep = static_cast<__mmask32>(_bzhi_u32(~0u, sign_byte_index + 1));
+    store(x, _mm256_mask_blend_epi8(keep, fill, load(x)));
+}
+}  // namespace detail
+#endif
+
+/// Computes x + y (mod 2**256).
+inline uint256 add(const uint256& x, const uint256& y) noexcept
+{
+#if ZVMONE_KERNELS_X86_64
+    uint256 r;
+    unsigned char c = 0;
+    for (size_t i = 0; i < uint256::num_words; ++i)
+        c = detail::addc(c, x[i], y[i], r[i]);
+    return r;
+#else
+    return x + y;
+#endif
+}
+
+/// Computes x - y (mod 2**256).
+inline uint256 sub(const uint256& x, const uint256& y) noexcept
+{
+#if ZVMONE_KERNELS_X86_64
+    uint256 r;
+    unsigned char b = 0;
+    for (size_t i = 0; i < uint256::num_words; ++i)
+        b = detail::subb(b, x[i], y[i], r[i]);
+    return r;
+#else
+    return x - y;
+#endif
+}
+
+/// Computes x < y.
+inline bool lt(const uint256& x, const uint256& y) noexcept
+{
+#if ZVMONE_KERNELS_X86_64 && defined(__AVX512VL__)
+    return detail::lt_avx512(x, y);
+#elif ZVMONE_KERNELS_X86_64
+    unsigned char b = 0;
+    uint64_t d;
+    for (size_t i = 0; i < uint256::num_words; ++i)
+        b = detail::subb(b, x[i], y[i], d);
+    return b != 0;
+#else
+    return x < y;
+#endif
+}
+
+/// Computes x == y.
+inline bool eq(const uint256& x, const uint256& y) noexcept
+{
+#if ZVMONE_KERNELS_X86_64 && defined(__AVX2__)
+    return detail::eq_avx2(x, y);
+#else
+    return x == y;
+#endif
+}
+
+/// Computes x == 0.
+inline bool is_zero(const uint256& x) noexcept
+{
+#if ZVMONE_KERNELS_X86_64 && defined(__AVX2__)
+    return detail::is_zero_avx2(x);
+#else
+    return x == 0;
+#endif
+}
+
+/// Sign-extends x from the byte of the given index (less than 31).
+inline void signextend(uint256& x, unsigned sign_byte_index) noexcept
+{
+#if ZVMONE_KERNELS_X86_64 && defined(__AVX512VL__) && defined(__AVX512BW__) && defined(__BMI2__)
+    detail::signextend_avx512(x, sign_byte_index);
+#else
+    const auto sign_word_index = sign_byte_index / 8;
+    const auto sign_byte_offset = sign_byte_index % 8 * 8;
+    auto& sign_word = x[sign_word_index];
+
+    // Sign-extend the "sign" byte and move it to the right position. Value bits are zeros.
+    const auto sign_byte = sign_word >> sign_byte_offset;
+    const auto sext_byte = static_cast<uint64_t>(int64_t{static_cast<int8_t>(sign_byte)});
+    const auto sext = sext_byte << sign_byte_offset;
+
+    const auto sign_mask = ~uint64_t{0} << sign_byte_offset;
+    const auto value = sign_word & ~sign_mask;  // Reset extended bytes.
+    sign_word = sext | value;                   // Combine the result word.
+
+    // Produce bits (all zeros or ones) for extended words. This is done by SAR of
+    // the sign-extended byte. Shift by any value 7-63 would work.
+    const auto sign_ex = static_cast<uint64_t>(static_cast<int64_t>(sext_byte) >> 8);
+
+    for (size_t i = 3; i > sign_word_index; --i)
+        x[i] = sign_ex;  // Clear extended words.
+#endif
+}
+}  // namespace zvmone::kernels
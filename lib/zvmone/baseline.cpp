@@ -81,7 +81,10 @@ namespace
 /// - if stack height requirements are fulfilled (stack overflow, stack underflow)
 /// - charges the instruction base gas cost and checks is there is any gas left.
 ///
+/// In the unmetered mode the base gas cost is only accumulated and never checked.
+///
 /// @tparam         Op            Instruction opcode.
+/// @tparam         Metered       Whether the base gas cost is checked against the gas left.
 /// @param          cost_table    Table of base gas costs.
 /// @param [in,out] gas_left      Gas left.
 /// @param          stack_top     Pointer to the stack top item.
@@ -89,7 +92,7 @@ namespace
 ///                               The stack height is stack_top - stack_bottom.
 /// @return  Status code with information which check has failed
 ///          or ZVMC_SUCCESS if everything is fine.
-template <Opcode Op>
+template <Opcode Op, bool Metered>
 inline zvmc_status_code check_requirements(const CostTable& cost_table, int64_t& gas_left,
     const uint256* stack_top, const uint256* stack_bottom) noexcept
 {
@@ -125,8 +128,13 @@ inline zvmc_status_code check_requirements(const CostTable& cost_table, int64_t&
             return ZVMC_STACK_UNDERFLOW;
     }
 
-    if (INTX_UNLIKELY((gas_left -= gas_cost) < 0))
-        return ZVMC_OUT_OF_GAS;
+    if constexpr (Metered)
+    {
+        if (INTX_UNLIKELY((gas_left -= gas_cost) < 0))
+            return ZVMC_OUT_OF_GAS;
+    }
+    else
+        gas_left -= gas_cost;  // Only accumulate the cost to report the approximate gas used.
 
     return ZVMC_SUCCESS;
 }
@@ -188,11 +196,12 @@ struct Position
 /// @}
 
 /// A helper to invoke the instruction implementation of the given opcode Op.
-template <Opcode Op>
+template <Opcode Op, bool Metered>
 [[release_inline]] inline Position invoke(const CostTable& cost_table, const uint256* stack_bottom,
     Position pos, int64_t& gas, ExecutionState& state) noexcept
 {
-    if (const auto status = check_requirements<Op>(cost_table, gas, pos.stack_top, stack_bottom);
+    if (const auto status =
+            check_requirements<Op, Metered>(cost_table, gas, pos.stack_top, stack_bottom);
         status != ZVMC_SUCCESS)
     {
         state.status = status;
@@ -204,7 +213,7 @@ template <Opcode Op>
 }
 
 
-template <bool TracingEnabled>
+template <bool TracingEnabled, bool Metered>
 int64_t dispatch(const CostTable& cost_table, ExecutionState& state, int64_t gas,
     const uint8_t* code, Tracer* tracer = nullptr) noexcept
 {
@@ -221,8 +230,10 @@ int64_t dispatch(const CostTable& cost_table, ExecutionState& state, int64_t gas
             const auto stack_height = static_cast<int>(position.stack_top - stack_bottom);
             if (offset < state.original_code.size())  // Skip STOP from code padding.
             {
+                // The unmetered execution reports the gas left relative to the gas limit.
+                const auto gas_left = Metered ? gas : observed_gas_left(gas, state);
                 tracer->notify_instruction_start(
-                    offset, position.stack_top, stack_height, gas, state);
+                    offset, position.stack_top, stack_height, gas_left, state);
             }
         }
 
@@ -232,7 +243,8 @@ int64_t dispatch(const CostTable& cost_table, ExecutionState& state, int64_t gas
 #define ON_OPCODE(OPCODE)                                                                     \
     case OPCODE:                                                                              \
         ASM_COMMENT(OPCODE);                                                                  \
-        if (const auto next = invoke<OPCODE>(cost_table, stack_bottom, position, gas, state); \
+        if (const auto next =                                                                 \
+                invoke<OPCODE, Metered>(cost_table, stack_bottom, position, gas, state);      \
             next.code_it == nullptr)                                                          \
         {                                                                                     \
             return gas;                                                                       \
@@ -257,6 +269,7 @@ int64_t dispatch(const CostTable& cost_table, ExecutionState& state, int64_t gas
 }
 
 #if ZVMONE_CGOTO_SUPPORTED
+template <bool Metered>
 int64_t dispatch_cgoto(
     const CostTable& cost_table, ExecutionState& state, int64_t gas, const uint8_t* code) noexcept
 {
@@ -282,7 +295,8 @@ int64_t dispatch_cgoto(
 
 #define ON_OPCODE(OPCODE)                                                                 \
     TARGET_##OPCODE : ASM_COMMENT(OPCODE);                                                \
-    if (const auto next = invoke<OPCODE>(cost_table, stack_bottom, position, gas, state); \
+    if (const auto next =                                                                 \
+            invoke<OPCODE, Metered>(cost_table, stack_bottom, position, gas, state);      \
         next.code_it == nullptr)                                                          \
     {                                                                                     \
         return gas;                                                                       \
@@ -303,6 +317,29 @@ TARGET_OP_UNDEFINED:
     return gas;
 }
 #endif
+
+/// The gas budget the unmetered execution starts with.
+///
+/// It is large enough for no dynamic gas check in instruction implementations to ever fail,
+/// but leaves enough headroom to accumulate base costs without overflowing int64_t.
+constexpr auto unmetered_gas_budget = std::numeric_limits<int64_t>::max() / 2;
+
+/// Selects the interpreter loop variant and executes the code.
+template <bool Metered>
+int64_t run(const VM& vm, const CostTable& cost_table, ExecutionState& state, int64_t gas,
+    const uint8_t* code, Tracer* tracer) noexcept
+{
+    if (INTX_UNLIKELY(tracer != nullptr))
+        return dispatch<true, Metered>(cost_table, state, gas, code, tracer);
+
+#if ZVMONE_CGOTO_SUPPORTED
+    if (vm.cgoto)
+        return dispatch_cgoto<Metered>(cost_table, state, gas, code);
+#else
+    (void)vm;
+#endif
+    return dispatch<false, Metered>(cost_table, state, gas, code);
+}
 }  // namespace
 
 zvmc_result execute(
@@ -316,26 +353,32 @@ zvmc_result execute(
 
     auto* tracer = vm.get_tracer();
     if (INTX_UNLIKELY(tracer != nullptr))
-    {
         tracer->notify_execution_start(state.rev, *state.msg, analysis.executable_code);
-        gas = dispatch<true>(cost_table, state, gas, code.data(), tracer);
-    }
-    else
+
+    if (INTX_UNLIKELY(vm.unmetered))
     {
-#if ZVMONE_CGOTO_SUPPORTED
-        if (vm.cgoto)
-            gas = dispatch_cgoto(cost_table, state, gas, code.data());
-        else
-#endif
-            gas = dispatch<false>(cost_table, state, gas, code.data());
+        // Execute with the large gas budget and report the gas used relative to the gas limit.
+        // The execution never runs out of gas, the gas left is clamped at 0 instead.
+        // The contract observes the gas left relative to the gas limit as well.
+        // The memory is limited to the size the gas limit could pay for, otherwise
+        // the execution could grow it until the allocation fails. Exceeding the limit is
+        // reported as out of gas.
+        state.unmetered_gas_offset = unmetered_gas_budget - gas;
+        state.memory.set_size_limit(max_memory_size(gas));
+        const auto budget_left =
+            run<false>(vm, cost_table, state, unmetered_gas_budget, code.data(), tracer);
+        const auto gas_used = unmetered_gas_budget - budget_left;
+        gas = std::max(gas - gas_used, int64_t{0});
     }
+    else
+        gas = run<true>(vm, cost_table, state, gas, code.data(), tracer);
 
     const auto gas_left = (state.status == ZVMC_SUCCESS || state.status == ZVMC_REVERT) ? gas : 0;
     const auto gas_refund = (state.status == ZVMC_SUCCESS) ? state.gas_refund : 0;
 
     assert(state.output_size != 0 || state.output_offset == 0);
-    const auto result = zvmc::make_result(state.status, gas_left, gas_refund,
-        state.output_size != 0 ? &state.memory[state.output_offset] : nullptr, state.output_size);
+    const auto result = state.memory.make_result(
+        state.status, gas_left, gas_refund, state.output_offset, state.output_size);
 
     if (INTX_UNLIKELY(tracer != nullptr))
         tracer->notify_execution_end(result);
@@ -347,9 +390,18 @@ zvmc_result execute(zvmc_vm* c_vm, const zvmc_host_interface* host, zvmc_host_co
     zvmc_revision rev, const zvmc_message* msg, const uint8_t* code, size_t code_size) noexcept
 {
     auto vm = static_cast<VM*>(c_vm);
-    const auto jumpdest_map = analyze(rev, {code, code_size});
+    const bytes_view container{code, code_size};
     auto state =
-        std::make_unique<ExecutionState>(*msg, rev, *host, ctx, bytes_view{code, code_size});
-    return execute(*vm, msg->gas, *state, jumpdest_map);
+        std::make_unique<ExecutionState>(*msg, rev, *host, ctx, container, vm->shared_stack);
+    state->memory.set_backend(vm->memory_backend);
+    state->host_extension = vm->get_host_extension(host);
+    if (vm->storage_cache)
+        state->storage_cache.enable();
+
+    const auto result = execute(*vm, msg->gas, *state, analyze(rev, container));
+
+    if (state->storage_cache.enabled())
+        vm->record_storage_cache_stats(state->storage_cache.stats());
+    return result;
 }
 }  // namespace zvmone::baseline
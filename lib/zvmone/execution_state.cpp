@@ -0,0 +1,620 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execution_state.hpp"
+#include <cassert>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+namespace zvmone
+{
+namespace
+{
+#if defined(__unix__) || defined(__APPLE__)
+/// Reserves the address space range of Memory::reserved_size. Returns null on failure.
+uint8_t* map_reservation() noexcept
+{
+    // The pages are committed by the OS on the first access so the NORESERVE mapping
+    // does not account the whole range against the system commit limit.
+    auto* const p = mmap(nullptr, Memory::reserved_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+    auto* const data = static_cast<uint8_t*>(p);
+
+#ifdef MADV_HUGEPAGE
+    // Only the big expansions use huge pages, the small ones would be slowed down
+    // by zeroing the whole huge page on the first access.
+    madvise(data + Memory::huge_page_threshold,
+        Memory::reserved_size - Memory::huge_page_threshold, MADV_HUGEPAGE);
+#endif
+    return data;
+}
+
+/// Returns the pages of the reserved range to the OS. The range reads as zeros afterwards.
+/// Returns false on failure.
+bool release_pages(uint8_t* data, size_t size) noexcept
+{
+#if defined(__linux__)
+    // The pages of the private anonymous mapping are zero-filled on the next access.
+    return madvise(data, size, MADV_DONTNEED) == 0;
+#else
+    // Elsewhere MADV_DONTNEED may keep the page contents so map fresh pages over the range.
+    return mmap(data, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) != MAP_FAILED;
+#endif
+}
+
+/// The reserved address space ranges released by Memory objects and kept for reuse
+/// by the same thread. Mapping a new range costs system calls and page faults
+/// on the first access to every page.
+class ReservationCache
+{
+    static constexpr size_t capacity = 4;
+
+    struct Reservation
+    {
+        uint8_t* data = nullptr;
+
+        /// The size of the range prefix which may contain non-zero bytes.
+        size_t dirty_size = 0;
+    };
+
+    Reservation m_reservations[capacity];
+    size_t m_size = 0;
+
+public:
+    ReservationCache() noexcept = default;
+    ReservationCache(const ReservationCache&) = delete;
+    ReservationCache& operator=(const ReservationCache&) = delete;
+
+    ~ReservationCache() noexcept
+    {
+        for (size_t i = 0; i < m_size; ++i)
+            munmap(m_reservations[i].data, Memory::reserved_size);
+    }
+
+    /// Takes a cached reservation. Returns false if the cache is empty.
+    bool take(uint8_t*& data, size_t& dirty_size) noexcept
+    {
+        if (m_size == 0)
+            return false;
+        const auto& r = m_reservations[--m_size];
+        data = r.data;
+        dirty_size = r.dirty_size;
+        return true;
+    }
+
+    /// Puts the reservation to the cache or unmaps it if the cache is full.
+    /// The pages above the retained dirty size are returned to the OS so the idle
+    /// reservations do not keep the memory of big executions committed.
+    void put(uint8_t* data, size_t dirty_size) noexcept
+    {
+        if (m_size == capacity)
+        {
+            munmap(data, Memory::reserved_size);
+            return;
+        }
+
+        constexpr auto retained = Memory::retained_dirty_size;
+        if (dirty_size > retained && release_pages(data + retained, dirty_size - retained))
+            dirty_size = retained;
+        m_reservations[m_size++] = {data, dirty_size};
+    }
+};
+
+thread_local ReservationCache reservation_cache;
+#endif
+
+/// The heap buffers released by the execution results and reused by the results and
+/// the ZVM memories of the following executions in the same thread.
+class BufferPool
+{
+    static constexpr size_t capacity = 8;
+
+    /// The max size of a pooled buffer. Bigger buffers are freed.
+    static constexpr size_t max_buffer_size = 1024 * 1024;
+
+    struct Buffer
+    {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    Buffer m_buffers[capacity];
+    size_t m_size = 0;
+
+public:
+    BufferPool() noexcept = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool() noexcept
+    {
+        for (size_t i = 0; i < m_size; ++i)
+            std::free(m_buffers[i].data);
+    }
+
+    /// Takes a buffer of at least the given size and at most the given max size
+    /// and updates the size to the buffer size. Returns null if there is no such buffer.
+    uint8_t* take(size_t& size, size_t max_size = std::numeric_limits<size_t>::max()) noexcept
+    {
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            if (m_buffers[i].size >= size && m_buffers[i].size <= max_size)
+            {
+                const auto buffer = m_buffers[i];
+                m_buffers[i] = m_buffers[--m_size];
+                size = buffer.size;
+                return buffer.data;
+            }
+        }
+        return nullptr;
+    }
+
+    /// Puts the buffer to the pool or frees it.
+    void put(uint8_t* data, size_t size) noexcept
+    {
+        if (m_size == capacity || size > max_buffer_size)
+            std::free(data);
+        else
+            m_buffers[m_size++] = {data, size};
+    }
+};
+
+thread_local BufferPool buffer_pool;
+
+/// The information of the buffer handed over to the execution result by Memory::make_result().
+/// It is stored right in front of the output data: over the memory bytes preceding the output
+/// and the space of Memory::buffer_header_size reserved in front of the memory buffer.
+struct BufferHeader
+{
+    /// The beginning of the buffer.
+    uint8_t* base;
+
+    /// The size of the buffer. For the virtual memory the size of the dirty prefix.
+    size_t size;
+
+    /// The backend the buffer is allocated with.
+    Memory::Backend placement;
+};
+static_assert(sizeof(BufferHeader) <= Memory::buffer_header_size);
+static_assert(std::is_trivially_copyable_v<BufferHeader>);
+
+/// Releases the output buffer of the result created by Memory::make_result().
+void release_result_buffer(const zvmc_result* result) noexcept
+{
+    BufferHeader header;
+    std::memcpy(&header, result->output_data - sizeof(header), sizeof(header));
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (header.placement == Memory::Backend::virtual_memory)
+    {
+        reservation_cache.put(header.base, header.size);
+        return;
+    }
+#endif
+    buffer_pool.put(header.base, header.size);
+}
+}  // namespace
+
+/// The memory arena of a thread shared by the nested executions.
+///
+/// The memory of every execution is a segment of a single reserved range starting
+/// at the end of the memory of the enclosing execution. The segments are released in
+/// the reverse order so the hot pages are reused by the following executions.
+struct Memory::Arena
+{
+    /// The reserved range. Null if not reserved yet or the reservation failed.
+    uint8_t* begin = nullptr;
+
+    /// The end of the range prefix which may contain non-zero bytes.
+    uint8_t* dirty_end = nullptr;
+
+    /// The memory of the innermost execution placed in the arena.
+    Memory* innermost = nullptr;
+
+    /// Whether the reservation has failed so it is not tried again.
+    bool failed = false;
+
+    Arena() noexcept = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        assert(innermost == nullptr);
+        if (begin != nullptr)
+            munmap(begin, reserved_size);
+#endif
+    }
+
+    /// Reserves the range if not done yet. Returns false on failure.
+    bool init() noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (begin == nullptr && !failed)
+        {
+            begin = dirty_end = map_reservation();
+            failed = (begin == nullptr);
+        }
+        return begin != nullptr;
+#else
+        return false;
+#endif
+    }
+};
+
+thread_local Memory::Arena Memory::s_arena;
+
+namespace
+{
+/// The stack region shared by the nested executions of a thread.
+class StackRegion
+{
+    /// The max number of the nested executions: the depth limit of 1024 plus the top execution.
+    static constexpr size_t max_executions = 1025;
+
+    /// The size of the guard pages surrounding the region.
+    static constexpr size_t guard_size = 64 * 1024;
+
+    static constexpr size_t size = max_executions * StackSpace::limit * sizeof(uint256);
+
+    /// The size of the region prefix kept committed for reuse. The pages dirtied above
+    /// by deep call chains are returned to the OS when the outermost execution ends.
+    static constexpr size_t retained_size = Memory::retained_dirty_size;
+
+    uint8_t* m_mapping = nullptr;
+    bool m_failed = false;
+
+    /// The high-water mark: the end of the stack spaces used since the pages were released.
+    uint8_t* m_dirty_end = nullptr;
+
+    [[nodiscard]] uint8_t* begin() const noexcept { return m_mapping + guard_size; }
+
+public:
+    /// The beginning of the stack of the next nested execution.
+    uint256* top = nullptr;
+
+    StackRegion() noexcept = default;
+    StackRegion(const StackRegion&) = delete;
+    StackRegion& operator=(const StackRegion&) = delete;
+
+    ~StackRegion() noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (m_mapping != nullptr)
+            munmap(m_mapping, size + 2 * guard_size);
+#endif
+    }
+
+    /// Reserves the region if not done yet. Returns false on failure.
+    bool init() noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (m_mapping != nullptr || m_failed)
+            return m_mapping != nullptr;
+
+        auto* const p = mmap(nullptr, size + 2 * guard_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        m_failed = (p == MAP_FAILED);
+        if (m_failed)
+            return false;
+        m_mapping = static_cast<uint8_t*>(p);
+
+        if (mprotect(m_mapping + guard_size, size, PROT_READ | PROT_WRITE) != 0)
+        {
+            munmap(m_mapping, size + 2 * guard_size);
+            m_mapping = nullptr;
+            m_failed = true;
+            return false;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        top = reinterpret_cast<uint256*>(begin());
+        m_dirty_end = begin();
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// Returns the stack space of the next execution. The region must be initialized.
+    uint256* acquire() noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto* const end = reinterpret_cast<uint8_t*>(top + StackSpace::limit);
+        m_dirty_end = std::max(m_dirty_end, end);
+        return top;
+    }
+
+    /// Releases the stack space of the execution. Once the outermost execution ends,
+    /// the pages above the retained size are returned to the OS.
+    void release(uint256* stack_space) noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (reinterpret_cast<uint8_t*>(stack_space) != begin())
+            return;
+        auto* const retained_end = begin() + retained_size;
+        if (m_dirty_end > retained_end &&
+            release_pages(retained_end, static_cast<size_t>(m_dirty_end - retained_end)))
+            m_dirty_end = retained_end;
+#else
+        (void)stack_space;
+#endif
+    }
+};
+
+thread_local StackRegion stack_region;
+}  // namespace
+
+StackSpace::StackSpace(bool shared) noexcept
+{
+    if (shared && stack_region.init())
+    {
+        m_stack_space = stack_region.acquire();
+        m_shared = true;
+        return;
+    }
+
+    m_stack_space = static_cast<uint256*>(operator new(
+        limit * sizeof(uint256), std::align_val_t{sizeof(uint256)}, std::nothrow));
+    if (m_stack_space == nullptr)
+        std::terminate();
+}
+
+StackSpace::~StackSpace() noexcept
+{
+    if (m_shared)
+        stack_region.release(m_stack_space);
+    else
+        operator delete(m_stack_space, std::align_val_t{sizeof(uint256)});
+}
+
+StackSpace::NestedScope::NestedScope(const StackSpace& stack_space, uint256* top) noexcept
+  : m_active{stack_space.is_shared()}
+{
+    if (m_active)
+    {
+        m_prev_top = stack_region.top;
+        stack_region.top = top + 1;
+    }
+}
+
+StackSpace::NestedScope::~NestedScope() noexcept
+{
+    if (m_active)
+        stack_region.top = m_prev_top;
+}
+
+Memory::~Memory() noexcept
+{
+    switch (m_placement)
+    {
+    case Backend::heap:
+        std::free(buffer_base());
+        break;
+    case Backend::virtual_memory:
+#if defined(__unix__) || defined(__APPLE__)
+        reservation_cache.put(buffer_base(), buffer_header_size + m_dirty_size);
+#endif
+        break;
+    case Backend::arena:
+        release_segment();
+        break;
+    }
+}
+
+bool Memory::reserve() noexcept
+{
+#if defined(__unix__) || defined(__APPLE__)
+    uint8_t* base = nullptr;
+    size_t dirty_size = 0;
+    if (!reservation_cache.take(base, dirty_size))
+    {
+        base = map_reservation();
+        if (base == nullptr)
+            return false;
+    }
+
+    // The memory above the current size is going to be zeroed by grow() if dirty.
+    auto* const data = base + buffer_header_size;
+    if (m_size != 0)
+        std::memcpy(data, m_data, m_size);
+    std::free(buffer_base());
+    m_data = data;
+    m_capacity = reserved_size - buffer_header_size;
+    m_dirty_size = std::max(dirty_size - std::min(dirty_size, buffer_header_size), m_size);
+    m_placement = Backend::virtual_memory;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Memory::acquire_segment() noexcept
+{
+    auto& arena = s_arena;
+    if (!arena.init())
+        return false;
+
+    // The memory of the enclosing execution cannot grow until this one is released.
+    auto* data = arena.begin;
+    auto* dirty_end = arena.dirty_end;
+    if (const auto* parent = arena.innermost; parent != nullptr)
+    {
+        data = parent->m_data + parent->m_size;
+        dirty_end = std::max(dirty_end, parent->m_data + parent->m_dirty_size);
+    }
+    const auto capacity = reserved_size - static_cast<size_t>(data - arena.begin);
+    if (m_size > capacity)
+        return false;
+
+    if (m_size != 0)
+        std::memcpy(data, m_data, m_size);
+    std::free(buffer_base());
+    m_data = data;
+    m_capacity = capacity;
+    m_dirty_size = std::max(static_cast<size_t>(std::max(dirty_end, data) - data), m_size);
+    m_parent = arena.innermost;
+    m_placement = Backend::arena;
+    arena.innermost = this;
+    return true;
+}
+
+void Memory::release_segment() noexcept
+{
+    auto& arena = s_arena;
+
+    // The segments must be released in the reverse order. Otherwise, the memory of a live
+    // execution placed above this segment would be overwritten by the following executions.
+    if (INTX_UNLIKELY(arena.innermost != this))
+        std::terminate();
+
+    // Propagate the dirty memory to the enclosing execution which may grow over it.
+    const auto dirty_end = m_data + m_dirty_size;
+    arena.dirty_end = std::max(arena.dirty_end, dirty_end);
+    if (m_parent != nullptr)
+    {
+        m_parent->m_dirty_size =
+            std::max(m_parent->m_dirty_size, static_cast<size_t>(dirty_end - m_parent->m_data));
+    }
+    arena.innermost = m_parent;
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Once the arena is empty, return the pages above the high-water mark to the OS
+    // so the memory expansion of a single execution is not kept committed by the thread.
+    const auto retained_end = arena.begin + retained_dirty_size;
+    if (arena.innermost == nullptr && arena.dirty_end > retained_end &&
+        release_pages(retained_end, static_cast<size_t>(arena.dirty_end - retained_end)))
+        arena.dirty_end = retained_end;
+#endif
+}
+
+void Memory::grow_capacity(size_t new_size) noexcept
+{
+    if (m_placement != Backend::heap)  // The reserved space is exhausted.
+        handle_out_of_memory();
+
+    if (m_backend == Backend::arena && acquire_segment() && new_size <= m_capacity)
+        return;
+
+    if (m_backend == Backend::virtual_memory && new_size > heap_size_limit &&
+        new_size <= reserved_size - buffer_header_size && reserve())
+        return;
+
+    if (m_placement != Backend::heap)  // The arena is exhausted.
+        handle_out_of_memory();
+
+    m_capacity *= 2;  // Double the capacity.
+
+    if (m_capacity < new_size)  // If not enough.
+    {
+        // Set capacity to required size rounded to multiple of page_size.
+        m_capacity = ((new_size + (page_size - 1)) / page_size) * page_size;
+    }
+
+    if (m_data == nullptr)
+    {
+        auto size = buffer_header_size + m_capacity;
+        if (auto* const buffer = buffer_pool.take(size); buffer != nullptr)
+        {
+            m_data = buffer + buffer_header_size;
+            m_capacity = m_dirty_size = size - buffer_header_size;
+            return;
+        }
+    }
+
+    allocate_capacity();
+}
+
+zvmc_result Memory::make_result(zvmc_status_code status_code, int64_t gas_left,
+    int64_t gas_refund, size_t output_offset, size_t output_size) noexcept
+{
+    if (output_size == 0)
+        return zvmc::make_result(status_code, gas_left, gas_refund, nullptr, 0);
+
+    BufferHeader header{};
+    uint8_t* output = nullptr;
+    if (m_placement != Backend::arena && output_size > max_copied_output_size &&
+        output_offset <= output_size)
+    {
+        // Hand over the memory buffer. The memory is left empty.
+        // The buffer is trimmed after the output so the return data of the caller
+        // only keeps the output and the memory in front of it.
+        header.base = buffer_base();
+        header.placement = m_placement;
+        const auto used_size = buffer_header_size + output_offset + output_size;
+        if (m_placement == Backend::virtual_memory)
+        {
+            header.size = buffer_header_size + m_dirty_size;
+#if defined(__unix__) || defined(__APPLE__)
+            const auto retained_size = ((used_size + (page_size - 1)) / page_size) * page_size;
+            if (header.size > retained_size &&
+                release_pages(header.base + retained_size, header.size - retained_size))
+                header.size = retained_size;
+#endif
+        }
+        else
+        {
+            header.size = buffer_header_size + m_capacity;
+            if (used_size < header.size)
+            {
+                if (auto* const base = static_cast<uint8_t*>(std::realloc(header.base, used_size));
+                    base != nullptr)
+                {
+                    header.base = base;
+                    header.size = used_size;
+                }
+            }
+        }
+        output = header.base + buffer_header_size + output_offset;
+        m_data = nullptr;
+        m_size = m_capacity = m_dirty_size = 0;
+        m_placement = Backend::heap;
+    }
+    else
+    {
+        // Copy the small output or the output of the memory in the arena, whose segment
+        // is reused by the following executions, to a pooled buffer.
+        header.size = sizeof(header) + output_size;
+        header.base = buffer_pool.take(header.size, std::max(2 * header.size, page_size));
+        if (header.base == nullptr)
+        {
+            header.base = static_cast<uint8_t*>(std::malloc(header.size));
+            if (header.base == nullptr)
+                handle_out_of_memory();
+        }
+        header.placement = Backend::heap;
+        output = header.base + sizeof(header);
+        std::memcpy(output, &m_data[output_offset], output_size);
+    }
+
+    // The header overwrites the memory bytes preceding the output, which are not needed anymore,
+    // or the space reserved in front of the buffer.
+    std::memcpy(output - sizeof(header), &header, sizeof(header));
+
+    zvmc_result result{};
+    result.status_code = status_code;
+    result.gas_left = gas_left;
+    result.gas_refund = gas_refund;
+    result.output_data = output;
+    result.output_size = output_size;
+    result.release = release_result_buffer;
+    return result;
+}
+
+size_t Memory::get_result_buffer_size(const uint8_t* output_data) noexcept
+{
+    BufferHeader header;
+    std::memcpy(&header, output_data - sizeof(header), sizeof(header));
+    return header.size;
+}
+}  // namespace zvmone
@@ -3,11 +3,17 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "modular_arithmetic.hpp"
 #include <intx/intx.hpp>
 #include <zvmc/zvmc.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <vector>
 
+struct zvmone_host_extension;
+
 namespace zvmone
 {
 namespace advanced
@@ -25,58 +31,186 @@ using bytes_view = std::basic_string_view<uint8_t>;
 
 
 /// Provides memory for ZVM stack.
-class StackSpace
+///
+/// The stack space is either allocated for the exclusive use or is a part of the thread's
+/// shared stack region starting right above the stack items of the enclosing execution
+/// (see NestedScope). The shared region is reserved once, is committed lazily by the OS and
+/// is surrounded by guard pages.
+class ZVMC_EXPORT StackSpace
 {
 public:
     /// The maximum number of ZVM stack items.
     static constexpr auto limit = 1024;
 
+    /// Marks the stack items of the execution as used for the lifetime of the scope
+    /// so the stacks of the nested executions sharing the region are placed above them.
+    class ZVMC_EXPORT NestedScope
+    {
+        uint256* m_prev_top = nullptr;
+        bool m_active = false;
+
+    public:
+        /// @param stack_space  The stack space of the current execution.
+        /// @param top          The pointer to the top stack item of the current execution.
+        NestedScope(const StackSpace& stack_space, uint256* top) noexcept;
+        ~NestedScope() noexcept;
+
+        NestedScope(const NestedScope&) = delete;
+        NestedScope& operator=(const NestedScope&) = delete;
+    };
+
+    /// Allocates the stack space for the exclusive use.
+    StackSpace() noexcept : StackSpace{false} {}
+
+    /// Creates the stack space in the thread's shared stack region if requested and supported.
+    /// Otherwise, allocates the stack space for the exclusive use.
+    explicit StackSpace(bool shared) noexcept;
+
+    ~StackSpace() noexcept;
+
+    StackSpace(const StackSpace&) = delete;
+    StackSpace& operator=(const StackSpace&) = delete;
+
     /// Returns the pointer to the "bottom", i.e. below the stack space.
     [[nodiscard, clang::no_sanitize("bounds")]] uint256* bottom() noexcept
     {
         return m_stack_space - 1;
     }
 
+    /// Checks if the stack space is a part of the shared stack region.
+    [[nodiscard]] bool is_shared() const noexcept { return m_shared; }
+
 private:
-    /// The storage allocated for maximum possible number of items.
+    /// The storage for maximum possible number of items.
     /// Items are aligned to 256 bits for better packing in cache lines.
-    alignas(sizeof(uint256)) uint256 m_stack_space[limit];
+    uint256* m_stack_space = nullptr;
+
+    /// Whether the storage is a part of the shared stack region.
+    bool m_shared = false;
 };
 
 
 /// The ZVM memory.
 ///
-/// The implementations uses initial allocation of 4k and then grows capacity with 2x factor.
-/// Some benchmarks has been done to confirm 4k is ok-ish value.
-class Memory
+/// The implementations uses initial allocation of 4k on the first growth and then grows capacity
+/// with 2x factor. Some benchmarks has been done to confirm 4k is ok-ish value.
+///
+/// With the virtual memory backend, the memory growing above the small size threshold is moved
+/// once to a large reserved range of the virtual address space. The OS commits the pages of
+/// the range lazily on the first access so further growth neither copies the memory contents
+/// nor zeroes the fresh pages.
+///
+/// With the arena backend, the memory is a segment of the range reserved once per thread,
+/// placed right after the memory of the enclosing execution. The memories in the arena must be
+/// destroyed in the reverse order of their first growth, e.g. by the nested executions,
+/// otherwise the program is terminated. The pages dirtied above Memory::retained_dirty_size
+/// are returned to the OS when the outermost memory in the arena is destroyed.
+class ZVMC_EXPORT Memory
 {
+public:
+    /// The memory allocation strategy.
+    enum class Backend
+    {
+        heap,            ///< The memory is allocated with realloc.
+        virtual_memory,  ///< The memory is committed lazily in the reserved address space.
+        arena,           ///< The memory is a segment of the thread's memory arena.
+    };
+
+    /// The default backend. The other backends are opt-in.
+    static constexpr auto default_backend = Backend::heap;
+
+private:
+    struct Arena;
+
     /// The size of allocation "page".
     static constexpr size_t page_size = 4 * 1024;
 
+    /// The memory arena of the current thread.
+    static thread_local Arena s_arena;
+
     /// Pointer to allocated memory.
     uint8_t* m_data = nullptr;
 
     /// The "virtual" size of the memory.
     size_t m_size = 0;
 
-    /// The size of allocated memory. The initialization value is the initial capacity.
-    size_t m_capacity = page_size;
+    /// The size of allocated memory.
+    size_t m_capacity = 0;
+
+    /// The size of the memory prefix which may contain non-zero bytes.
+    /// The memory above this size is zero-initialized by the OS.
+    size_t m_dirty_size = 0;
+
+    /// The memory of the enclosing execution in the arena.
+    Memory* m_parent = nullptr;
+
+    /// The backend used for the memory growth.
+    Backend m_backend = default_backend;
+
+    /// The backend the memory is currently allocated with.
+    Backend m_placement = Backend::heap;
+
+    /// The max size the memory can grow to (see set_size_limit()).
+    size_t m_size_limit = std::numeric_limits<size_t>::max();
 
     [[noreturn, gnu::cold]] static void handle_out_of_memory() noexcept { std::terminate(); }
 
+    /// Returns the beginning of the heap or virtual memory buffer including the reserved header.
+    [[nodiscard]] uint8_t* buffer_base() const noexcept
+    {
+        return m_data != nullptr ? m_data - buffer_header_size : nullptr;
+    }
+
     void allocate_capacity() noexcept
     {
-        m_data = static_cast<uint8_t*>(std::realloc(m_data, m_capacity));
-        if (m_data == nullptr)
+        auto* const base =
+            static_cast<uint8_t*>(std::realloc(buffer_base(), buffer_header_size + m_capacity));
+        if (base == nullptr)
             handle_out_of_memory();
+        m_data = base + buffer_header_size;
+        m_dirty_size = m_capacity;
     }
 
+    /// Extends the capacity to fit at least the given size.
+    void grow_capacity(size_t new_size) noexcept;
+
+    /// Moves the memory to the reserved virtual address space. Returns false on failure.
+    bool reserve() noexcept;
+
+    /// Moves the memory to the top of the memory arena. Returns false on failure.
+    bool acquire_segment() noexcept;
+
+    /// Releases the memory segment from the top of the memory arena.
+    void release_segment() noexcept;
+
 public:
-    /// Creates Memory object with initial capacity allocation.
-    Memory() noexcept { allocate_capacity(); }
+    /// The memory size from which the virtual memory backend is used.
+    /// Smaller memories stay on the heap because reserving address space costs system calls.
+    static constexpr size_t heap_size_limit = 128 * 1024;
+
+    /// The size of the reserved virtual address space.
+    /// Expanding the ZVM memory to 4 GiB costs more than 10^13 gas.
+    static constexpr size_t reserved_size = size_t{1} << (sizeof(size_t) >= 8 ? 32 : 30);
+
+    /// The memory size from which transparent huge pages are requested for the reserved range.
+    static constexpr size_t huge_page_threshold = 2 * 1024 * 1024;
+
+    /// The space reserved in front of the heap and virtual memory buffers for the buffer
+    /// information of the execution result taking over the buffer (see make_result()).
+    static constexpr size_t buffer_header_size = 32;
+
+    /// The size of the dirty prefix of the reserved range kept committed for reuse.
+    /// The pages above are returned to the OS when the range is released.
+    static constexpr size_t retained_dirty_size = huge_page_threshold;
+
+    /// The max size of the output copied by make_result() instead of taking over the buffer.
+    static constexpr size_t max_copied_output_size = 16 * 1024;
+
+    /// Creates Memory object. The allocation is deferred to the first growth.
+    Memory() noexcept = default;
 
     /// Frees all allocated memory.
-    ~Memory() noexcept { std::free(m_data); }
+    ~Memory() noexcept;
 
     Memory(const Memory&) = delete;
     Memory& operator=(const Memory&) = delete;
@@ -86,6 +220,18 @@ public:
     [[nodiscard]] const uint8_t* data() const noexcept { return m_data; }
     [[nodiscard]] size_t size() const noexcept { return m_size; }
 
+    [[nodiscard]] Backend backend() const noexcept { return m_backend; }
+
+    /// Selects the backend for the future memory growth.
+    void set_backend(Backend backend) noexcept { m_backend = backend; }
+
+    /// Returns the max size the memory can grow to.
+    [[nodiscard]] size_t size_limit() const noexcept { return m_size_limit; }
+
+    /// Limits the memory growth. This is used by the unmetered execution where the memory
+    /// expansion cost does not limit the memory size.
+    void set_size_limit(size_t size_limit) noexcept { m_size_limit = size_limit; }
+
     /// Grows the memory to the given size. The extend is filled with zeros.
     ///
     /// @param new_size  New memory size. Must be larger than the current size and multiple of 32.
@@ -98,23 +244,140 @@ public:
         INTX_REQUIRE(new_size > m_size);
 
         if (new_size > m_capacity)
-        {
-            m_capacity *= 2;  // Double the capacity.
-
-            if (m_capacity < new_size)  // If not enough.
-            {
-                // Set capacity to required size rounded to multiple of page_size.
-                m_capacity = ((new_size + (page_size - 1)) / page_size) * page_size;
-            }
+            grow_capacity(new_size);
 
-            allocate_capacity();
-        }
-        std::memset(m_data + m_size, 0, new_size - m_size);
+        // Only the memory used before clear() must be zeroed explicitly.
+        if (m_size < m_dirty_size)
+            std::memset(m_data + m_size, 0, std::min(new_size, m_dirty_size) - m_size);
         m_size = new_size;
+        m_dirty_size = std::max(m_dirty_size, new_size);
     }
 
     /// Virtually clears the memory by setting its size to 0. The capacity stays unchanged.
     void clear() noexcept { m_size = 0; }
+
+    /// Creates the execution result with the output from the given range of the memory.
+    ///
+    /// The output bigger than max_copied_output_size and not preceded by more memory than its
+    /// size takes over the heap or virtual memory buffer without copying. The buffer is trimmed
+    /// after the output and the memory is left empty. Otherwise, and for the memory in the arena
+    /// whose segment is reused by the following executions, the output is copied to a pooled
+    /// buffer so the result does not keep the whole memory alive.
+    /// The information needed to release the buffer is stored right in front of the output data.
+    /// The released buffers are pooled for the following executions.
+    [[nodiscard]] zvmc_result make_result(zvmc_status_code status_code, int64_t gas_left,
+        int64_t gas_refund, size_t output_offset, size_t output_size) noexcept;
+
+    /// Returns the size of the buffer kept alive by the execution result created by make_result()
+    /// with the given non-empty output.
+    [[nodiscard]] static size_t get_result_buffer_size(const uint8_t* output_data) noexcept;
+};
+
+
+/// The output data of the last call. Owns the call result so the output is not copied.
+class ReturnData
+{
+    zvmc::Result m_result;
+
+public:
+    [[nodiscard]] const uint8_t* data() const noexcept { return m_result.output_data; }
+    [[nodiscard]] size_t size() const noexcept { return m_result.output_size; }
+
+    const uint8_t& operator[](size_t index) const noexcept { return m_result.output_data[index]; }
+
+    /// Takes the ownership of the call result.
+    ReturnData& operator=(zvmc::Result&& result) noexcept
+    {
+        m_result = std::move(result);
+        return *this;
+    }
+
+    void clear() noexcept { m_result = zvmc::Result{}; }
+};
+
+
+/// The cache of the storage values of the executing account read or written by
+/// the current execution frame.
+///
+/// The cached slots have been accessed by the frame so they are warm and the repeated SLOADs
+/// are served without the host calls. The cache must be cleared before the nested executions
+/// which may modify the storage of the account.
+class StorageCache
+{
+public:
+    /// The hit statistics of the cache.
+    struct Stats
+    {
+        uint64_t hits = 0;    ///< The number of SLOADs served from the cache.
+        uint64_t misses = 0;  ///< The number of SLOADs passed to the host.
+    };
+
+private:
+    static constexpr size_t num_entries = 16;
+
+    struct Entry
+    {
+        zvmc_bytes32 key;
+        zvmc_bytes32 value;
+    };
+
+    /// The direct-mapped entries. Only the entries marked in m_valid are initialized.
+    Entry m_entries[num_entries];
+
+    /// The bitset of the valid entries.
+    uint32_t m_valid = 0;
+    static_assert(num_entries <= 32);
+
+    bool m_enabled = false;
+
+    Stats m_stats;
+
+    static size_t index(const zvmc_bytes32& key) noexcept
+    {
+        // The keys are mostly small numbers or hashes so mixing the last and the first byte
+        // spreads both.
+        return (key.bytes[31] ^ key.bytes[0]) % num_entries;
+    }
+
+public:
+    [[nodiscard]] bool enabled() const noexcept { return m_enabled; }
+
+    void enable() noexcept { m_enabled = true; }
+
+    [[nodiscard]] const Stats& stats() const noexcept { return m_stats; }
+
+    /// Returns the cached value of the storage slot or nullptr if the slot is not cached.
+    const zvmc_bytes32* find(const zvmc_bytes32& key) noexcept
+    {
+        const auto i = index(key);
+        if ((m_valid & (uint32_t{1} << i)) != 0 &&
+            std::memcmp(m_entries[i].key.bytes, key.bytes, sizeof(key.bytes)) == 0)
+        {
+            ++m_stats.hits;
+            return &m_entries[i].value;
+        }
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    /// Records the current value of the storage slot accessed by the frame.
+    void insert(const zvmc_bytes32& key, const zvmc_bytes32& value) noexcept
+    {
+        const auto i = index(key);
+        m_entries[i] = {key, value};
+        m_valid |= uint32_t{1} << i;
+    }
+
+    /// Removes all cached values. The statistics are kept.
+    void clear() noexcept { m_valid = 0; }
+
+    /// Disables the cache and resets the statistics.
+    void reset() noexcept
+    {
+        m_valid = 0;
+        m_enabled = false;
+        m_stats = {};
+    }
 };
 
 
@@ -124,11 +387,24 @@ class ExecutionState
 {
 public:
     int64_t gas_refund = 0;
+
+    /// The difference between the gas budget of the unmetered execution and the message gas.
+    /// The gas left observed by the contract is lower by this offset. It is 0 when metered.
+    int64_t unmetered_gas_offset = 0;
+
     Memory memory;
     const zvmc_message* msg = nullptr;
     zvmc::HostContext host;
+
+    /// The optional host extension (see zvmone_set_host_extension()) or null.
+    /// Set by the execute() function of a particular interpreter.
+    const zvmone_host_extension* host_extension = nullptr;
+
+    /// The host context, for calling the host extension.
+    zvmc_host_context* host_context = nullptr;
+
     zvmc_revision rev = ZVMC_SHANGHAI;
-    bytes return_data;
+    ReturnData return_data;
 
     /// Reference to original ZVM code container.
     /// For legacy code this is a reference to entire original code.
@@ -152,17 +428,28 @@ public:
 
     std::vector<const uint8_t*> call_stack;
 
+    /// The Barrett constants of the MULMOD moduli repeated in the execution.
+    ModulusCache modulus_cache;
+
+    /// The optional cache of the storage values accessed by the frame.
+    StorageCache storage_cache;
+
     /// Stack space allocation.
-    ///
-    /// This is the last field to make other fields' offsets of reasonable values.
     StackSpace stack_space;
 
     ExecutionState() noexcept = default;
 
+    /// @param shared_stack  Whether to place the stack in the thread's shared stack region.
+    ///                      All live states sharing the region must be nested executions.
     ExecutionState(const zvmc_message& message, zvmc_revision revision,
-        const zvmc_host_interface& host_interface, zvmc_host_context* host_ctx,
-        bytes_view _code) noexcept
-      : msg{&message}, host{host_interface, host_ctx}, rev{revision}, original_code{_code}
+        const zvmc_host_interface& host_interface, zvmc_host_context* host_ctx, bytes_view _code,
+        bool shared_stack = false) noexcept
+      : msg{&message},
+        host{host_interface, host_ctx},
+        host_context{host_ctx},
+        rev{revision},
+        original_code{_code},
+        stack_space{shared_stack}
     {}
 
     /// Resets the contents of the ExecutionState so that it could be reused.
@@ -171,9 +458,13 @@ public:
         bytes_view _code) noexcept
     {
         gas_refund = 0;
+        unmetered_gas_offset = 0;
         memory.clear();
+        memory.set_size_limit(std::numeric_limits<size_t>::max());
         msg = &message;
         host = {host_interface, host_ctx};
+        host_extension = nullptr;
+        host_context = host_ctx;
         rev = revision;
         return_data.clear();
         original_code = _code;
@@ -181,6 +472,8 @@ public:
         output_offset = 0;
         output_size = 0;
         m_tx = {};
+        modulus_cache.clear();
+        storage_cache.reset();
     }
 
     [[nodiscard]] bool in_static_mode() const { return (msg->flags & ZVMC_STATIC) != 0; }
@@ -3,11 +3,15 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "arithmetic_kernels.hpp"
 #include "baseline.hpp"
 #include "execution_state.hpp"
 #include "instructions_traits.hpp"
 #include "instructions_xmacro.hpp"
-#include <ethash/keccak.hpp>
+#include "keccak.hpp"
+#include <array>
+#include <bit>
+#include <cmath>
 
 namespace zvmone
 {
@@ -62,6 +66,29 @@ inline constexpr int64_t num_words(uint64_t size_in_bytes) noexcept
     return static_cast<int64_t>((size_in_bytes + (word_size - 1)) / word_size);
 }
 
+/// Returns the total cost of the memory of the given size in words.
+inline constexpr int64_t memory_cost(int64_t words) noexcept
+{
+    return 3 * words + words * words / 512;
+}
+
+/// Returns the max memory size the gas limit can pay the memory expansion cost for.
+inline size_t max_memory_size(int64_t gas_limit) noexcept
+{
+    // The memory size is limited by max_buffer_size anyway.
+    constexpr auto max_words = num_words(2 * uint64_t{max_buffer_size});
+
+    // Solve the quadratic cost equation and correct the rounding.
+    auto words = static_cast<int64_t>(
+        256 * (std::sqrt(9.0 + static_cast<double>(std::max(gas_limit, int64_t{0})) / 128) - 3));
+    words = std::clamp(words, int64_t{0}, max_words);
+    while (words < max_words && memory_cost(words + 1) <= gas_limit)
+        ++words;
+    while (words > 0 && memory_cost(words) > gas_limit)
+        --words;
+    return static_cast<size_t>(words * word_size);
+}
+
 /// Grows ZVM memory and checks its cost.
 ///
 /// This function should not be inlined because this may affect other inlining decisions:
@@ -75,11 +102,14 @@ inline constexpr int64_t num_words(uint64_t size_in_bytes) noexcept
     // This implementation recomputes memory.size(). This value is already known to the caller
     // and can be passed as a parameter, but this make no difference to the performance.
 
+    // The limit is only set by the unmetered execution. Exceeding it means running out of gas
+    // under the gas limit of the message.
+    if (new_size > memory.size_limit()) [[unlikely]]
+        return -1;
+
     const auto new_words = num_words(new_size);
     const auto current_words = static_cast<int64_t>(memory.size() / word_size);
-    const auto new_cost = 3 * new_words + new_words * new_words / 512;
-    const auto current_cost = 3 * current_words + current_words * current_words / 512;
-    const auto cost = new_cost - current_cost;
+    const auto cost = memory_cost(new_words) - memory_cost(current_words);
 
     gas_left -= cost;
     if (gas_left >= 0) [[likely]]
@@ -120,6 +150,114 @@ inline bool check_memory(
     return check_memory(gas_left, memory, offset, static_cast<uint64_t>(size));
 }
 
+/// Returns the gas left as observed by the contract (GAS, CALL and CREATE instructions).
+///
+/// The unmetered execution runs with a large gas budget, so the gas left is reported
+/// relative to the message gas limit as in the metered execution. It is clamped at 0.
+inline int64_t observed_gas_left(int64_t gas_left, const ExecutionState& state) noexcept
+{
+    return std::max(gas_left - state.unmetered_gas_offset, int64_t{0});
+}
+
+/// Checks if both values fit in 64 bits.
+///
+/// The division instructions use this to select the native 64-bit arithmetic
+/// because narrow operands (indexes, fixed-point math) are the common case.
+inline bool fit_64(const uint256& x, const uint256& y) noexcept
+{
+    return (x[3] | x[2] | x[1] | y[3] | y[2] | y[1]) == 0;
+}
+
+/// Checks if both values fit in 128 bits.
+inline bool fit_128(const uint256& x, const uint256& y) noexcept
+{
+    return (x[3] | x[2] | y[3] | y[2]) == 0;
+}
+
+/// Checks if both values are sign-extended 64-bit integers.
+inline bool fit_int64(const uint256& x, const uint256& y) noexcept
+{
+    const auto x_ext = static_cast<uint64_t>(static_cast<int64_t>(x[0]) >> 63);
+    const auto y_ext = static_cast<uint64_t>(static_cast<int64_t>(y[0]) >> 63);
+    return ((x[3] ^ x_ext) | (x[2] ^ x_ext) | (x[1] ^ x_ext) | (y[3] ^ y_ext) | (y[2] ^ y_ext) |
+               (y[1] ^ y_ext)) == 0;
+}
+
+/// Returns the absolute value of the sign-extended 64-bit integer.
+/// The result is unsigned to also handle the minimal value.
+inline uint64_t abs_int64(uint64_t x) noexcept
+{
+    return static_cast<int64_t>(x) < 0 ? 0 - x : x;
+}
+
+/// Returns the base 2 logarithm of the value if it is a power of two, otherwise -1.
+inline int log2_if_pow2(const uint256& x) noexcept
+{
+    int log2 = -1;
+    for (size_t i = 0; i < uint256::num_words; ++i)
+    {
+        if (x[i] == 0)
+            continue;
+        if (log2 >= 0 || (x[i] & (x[i] - 1)) != 0)
+            return -1;
+        log2 = static_cast<int>(i * 64) + std::countr_zero(x[i]);
+    }
+    return log2;
+}
+
+/// The powers of 10 not exceeding 256 bits: 10**0 ... 10**77.
+inline const auto pow10_table = [] {
+    std::array<uint256, 78> table{1};
+    for (size_t i = 1; i < table.size(); ++i)
+        table[i] = table[i - 1] * 10;
+    return table;
+}();
+
+/// Computes base**exponent (mod 2**256) with the sliding window method.
+///
+/// The exponent is processed from the most significant bit in windows of up to 4 bits
+/// ending with a set bit. This needs one multiplication per window by one of
+/// the precomputed odd powers instead of one multiplication per set bit.
+inline uint256 exp_sliding_window(const uint256& base, const uint256& exponent) noexcept
+{
+    constexpr int window_size = 4;
+    const auto bit = [&exponent](int i) noexcept {
+        return static_cast<unsigned>(exponent[static_cast<size_t>(i / 64)] >> (i % 64)) & 1;
+    };
+
+    // The odd powers: base**1, base**3, ..., base**15.
+    uint256 odd_powers[1 << (window_size - 1)];
+    odd_powers[0] = base;
+    const auto base_squared = base * base;
+    for (size_t i = 1; i < std::size(odd_powers); ++i)
+        odd_powers[i] = odd_powers[i - 1] * base_squared;
+
+    uint256 result = 1;
+    for (int i = 255 - static_cast<int>(intx::clz(exponent)); i >= 0;)
+    {
+        if (bit(i) == 0)
+        {
+            result *= result;
+            --i;
+            continue;
+        }
+
+        auto low = std::max(i - (window_size - 1), 0);
+        while (bit(low) == 0)
+            ++low;
+
+        unsigned window = 0;
+        for (auto j = i; j >= low; --j)
+        {
+            window = (window << 1) | bit(j);
+            result *= result;
+        }
+        result *= odd_powers[window >> 1];
+        i = low - 1;
+    }
+    return result;
+}
+
 namespace instr::core
 {
 
@@ -146,7 +284,9 @@ inline constexpr auto invalid = stop_impl<ZVMC_INVALID_INSTRUCTION>;
 
 inline void add(StackTop stack) noexcept
 {
-    stack.top() += stack.pop();
+    const auto& x = stack.pop();
+    auto& y = stack.top();
+    y = kernels::add(x, y);
 }
 
 inline void mul(StackTop stack) noexcept
@@ -156,31 +296,76 @@ inline void mul(StackTop stack) noexcept
 
 inline void sub(StackTop stack) noexcept
 {
-    stack[1] = stack[0] - stack[1];
+    stack[1] = kernels::sub(stack[0], stack[1]);
 }
 
 inline void div(StackTop stack) noexcept
 {
+    const auto& x = stack[0];
     auto& v = stack[1];
-    v = v != 0 ? stack[0] / v : 0;
+    if (fit_64(x, v))
+        v = v[0] != 0 ? x[0] / v[0] : 0;
+    else if (fit_128(x, v))
+    {
+        const intx::uint128 d{v[0], v[1]};
+        const auto q = d != 0 ? intx::uint128{x[0], x[1]} / d : intx::uint128{};
+        v = uint256{q[0], q[1]};
+    }
+    else
+        v = v != 0 ? x / v : 0;
 }
 
 inline void sdiv(StackTop stack) noexcept
 {
+    const auto& x = stack[0];
     auto& v = stack[1];
-    v = v != 0 ? intx::sdivrem(stack[0], v).quot : 0;
+    if (fit_int64(x, v))
+    {
+        if (v[0] != 0)
+        {
+            const uint256 q = abs_int64(x[0]) / abs_int64(v[0]);
+            v = ((x[0] ^ v[0]) >> 63) != 0 ? -q : q;
+        }
+        else
+            v = 0;
+    }
+    else
+        v = v != 0 ? intx::sdivrem(x, v).quot : 0;
 }
 
 inline void mod(StackTop stack) noexcept
 {
+    const auto& x = stack[0];
     auto& v = stack[1];
-    v = v != 0 ? stack[0] % v : 0;
+    if (fit_64(x, v))
+        v = v[0] != 0 ? x[0] % v[0] : 0;
+    else if (fit_128(x, v))
+    {
+        const intx::uint128 d{v[0], v[1]};
+        const auto r = d != 0 ? intx::uint128{x[0], x[1]} % d : intx::uint128{};
+        v = uint256{r[0], r[1]};
+    }
+    else
+        v = v != 0 ? x % v : 0;
 }
 
 inline void smod(StackTop stack) noexcept
 {
+    const auto& x = stack[0];
     auto& v = stack[1];
-    v = v != 0 ? intx::sdivrem(stack[0], v).rem : 0;
+    if (fit_int64(x, v))
+    {
+        if (v[0] != 0)
+        {
+            // The result has the sign of the dividend.
+            const uint256 r = abs_int64(x[0]) % abs_int64(v[0]);
+            v = (x[0] >> 63) != 0 ? -r : r;
+        }
+        else
+            v = 0;
+    }
+    else
+        v = v != 0 ? intx::sdivrem(x, v).rem : 0;
 }
 
 inline void addmod(StackTop stack) noexcept
@@ -188,15 +373,33 @@ inline void addmod(StackTop stack) noexcept
     const auto& x = stack.pop();
     const auto& y = stack.pop();
     auto& m = stack.top();
-    m = m != 0 ? intx::addmod(x, y, m) : 0;
+    if (fit_64(x, y) && fit_64(m, m))
+    {
+        // The sum fits in 65 bits.
+        const auto sum = intx::uint128{x[0]} + y[0];
+        m = m[0] != 0 ? (sum % m[0])[0] : 0;
+    }
+    else
+        m = m != 0 ? intx::addmod(x, y, m) : 0;
 }
 
-inline void mulmod(StackTop stack) noexcept
+inline void mulmod(StackTop stack, ExecutionState& state) noexcept
 {
     const auto& x = stack[0];
     const auto& y = stack[1];
     auto& m = stack[2];
-    m = m != 0 ? intx::mulmod(x, y, m) : 0;
+    if (fit_64(x, y) && fit_64(m, m))
+        m = m[0] != 0 ? (intx::umul(x[0], y[0]) % m[0])[0] : 0;
+    else if (BarrettModulus::is_supported(m))
+    {
+        // Wide moduli are likely to repeat, e.g. in elliptic curve arithmetic.
+        if (const auto* barrett = state.modulus_cache.find(m); barrett != nullptr)
+            m = barrett->mulmod(x, y);
+        else
+            m = intx::mulmod(x, y, m);
+    }
+    else
+        m = m != 0 ? intx::mulmod(x, y, m) : 0;
 }
 
 inline Result exp(StackTop stack, int64_t gas_left, ExecutionState& /*state*/) noexcept
@@ -206,12 +409,28 @@ inline Result exp(StackTop stack, int64_t gas_left, ExecutionState& /*state*/) n
 
     const auto exponent_significant_bytes =
         static_cast<int>(intx::count_significant_bytes(exponent));
-    const auto exponent_cost = 50;
-    const auto additional_cost = exponent_significant_bytes * exponent_cost;
+    const auto additional_cost = exponent_significant_bytes * exp_byte_cost;
     if ((gas_left -= additional_cost) < 0)
         return {ZVMC_OUT_OF_GAS, gas_left};
 
-    exponent = intx::exp(base, exponent);
+    if (const auto base_log2 = log2_if_pow2(base); base_log2 >= 0)
+    {
+        // (2**k)**e = 1 << (k * e). This also covers the base 1.
+        if (base_log2 == 0)
+            exponent = 1;
+        else
+        {
+            const auto shift =
+                exponent < 256 ? static_cast<uint64_t>(base_log2) * exponent[0] : uint64_t{256};
+            exponent = shift < 256 ? uint256{1} << shift : 0;
+        }
+    }
+    else if (base == 10 && exponent < pow10_table.size())
+        exponent = pow10_table[static_cast<size_t>(exponent[0])];
+    else if (exponent_significant_bytes > 4)
+        exponent = exp_sliding_window(base, exponent);
+    else
+        exponent = intx::exp(base, exponent);
     return {ZVMC_SUCCESS, gas_left};
 }
 
@@ -221,43 +440,19 @@ inline void signextend(StackTop stack) noexcept
     auto& x = stack.top();
 
     if (ext < 31)  // For 31 we also don't need to do anything.
-    {
-        const auto e = ext[0];  // uint256 -> uint64.
-        const auto sign_word_index =
-            static_cast<size_t>(e / sizeof(e));      // Index of the word with the sign bit.
-        const auto sign_byte_index = e % sizeof(e);  // Index of the sign byte in the sign word.
-        auto& sign_word = x[sign_word_index];
-
-        const auto sign_byte_offset = sign_byte_index * 8;
-        const auto sign_byte = sign_word >> sign_byte_offset;  // Move sign byte to position 0.
-
-        // Sign-extend the "sign" byte and move it to the right position. Value bits are zeros.
-        const auto sext_byte = static_cast<uint64_t>(int64_t{static_cast<int8_t>(sign_byte)});
-        const auto sext = sext_byte << sign_byte_offset;
-
-        const auto sign_mask = ~uint64_t{0} << sign_byte_offset;
-        const auto value = sign_word & ~sign_mask;  // Reset extended bytes.
-        sign_word = sext | value;                   // Combine the result word.
-
-        // Produce bits (all zeros or ones) for extended words. This is done by SAR of
-        // the sign-extended byte. Shift by any value 7-63 would work.
-        const auto sign_ex = static_cast<uint64_t>(static_cast<int64_t>(sext_byte) >> 8);
-
-        for (size_t i = 3; i > sign_word_index; --i)
-            x[i] = sign_ex;  // Clear extended words.
-    }
+        kernels::signextend(x, static_cast<unsigned>(ext[0]));
 }
 
 inline void lt(StackTop stack) noexcept
 {
     const auto& x = stack.pop();
-    stack[0] = x < stack[0];
+    stack[0] = kernels::lt(x, stack[0]);
 }
 
 inline void gt(StackTop stack) noexcept
 {
     const auto& x = stack.pop();
-    stack[0] = stack[0] < x;  // Arguments are swapped and < is used.
+    stack[0] = kernels::lt(stack[0], x);  // Arguments are swapped and < is used.
 }
 
 inline void slt(StackTop stack) noexcept
@@ -274,12 +469,12 @@ inline void sgt(StackTop stack) noexcept
 
 inline void eq(StackTop stack) noexcept
 {
-    stack[1] = stack[0] == stack[1];
+    stack[1] = kernels::eq(stack[0], stack[1]);
 }
 
 inline void iszero(StackTop stack) noexcept
 {
-    stack.top() = stack.top() == 0;
+    stack.top() = kernels::is_zero(stack.top());
 }
 
 inline void and_(StackTop stack) noexcept
@@ -355,7 +550,7 @@ inline Result keccak256(StackTop stack, int64_t gas_left, ExecutionState& state)
         return {ZVMC_OUT_OF_GAS, gas_left};
 
     auto data = s != 0 ? &state.memory[i] : nullptr;
-    size = intx::be::load<uint256>(ethash::keccak256(data, s));
+    size = intx::be::load<uint256>(zvmone::keccak256(data, s));
     return {ZVMC_SUCCESS, gas_left};
 }
 
@@ -720,9 +915,9 @@ inline void msize(StackTop stack, ExecutionState& state) noexcept
     stack.push(state.memory.size());
 }
 
-inline Result gas(StackTop stack, int64_t gas_left, ExecutionState& /*state*/) noexcept
+inline Result gas(StackTop stack, int64_t gas_left, ExecutionState& state) noexcept
 {
-    stack.push(gas_left);
+    stack.push(observed_gas_left(gas_left, state));
     return {ZVMC_SUCCESS, gas_left};
 }
 
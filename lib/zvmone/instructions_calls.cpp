@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "instructions.hpp"
+#include <zvmone/zvmone.h>
 
 namespace zvmone::instr::core
 {
@@ -15,6 +16,7 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
     const auto dst = intx::be::trunc<zvmc::address>(stack.pop());
     const auto value = (Op == OP_STATICCALL || Op == OP_DELEGATECALL) ? 0 : stack.pop();
     const auto has_value = value != 0;
+    const auto value_be = intx::be::store<zvmc::uint256be>(value);
     const auto input_offset_u256 = stack.pop();
     const auto input_size_u256 = stack.pop();
     const auto output_offset_u256 = stack.pop();
@@ -23,7 +25,19 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
     stack.push(0);  // Assume failure.
     state.return_data.clear();
 
-    if (state.host.access_account(dst) == ZVMC_ACCESS_COLD)
+    // The host extension answers all the host queries of the call at once.
+    const auto* const host_ext = state.host_extension;
+    const auto has_preflight = host_ext != nullptr && host_ext->call_preflight != nullptr;
+    zvmone_call_preflight preflight{};
+    if (has_preflight)
+    {
+        host_ext->call_preflight(
+            state.host_context, &state.msg->recipient, &dst, &value_be, &preflight);
+    }
+
+    const auto access_status =
+        has_preflight ? preflight.access_status : state.host.access_account(dst);
+    if (access_status == ZVMC_ACCESS_COLD)
     {
         if ((gas_left -= instr::additional_cold_account_access_cost) < 0)
             return {ZVMC_OUT_OF_GAS, gas_left};
@@ -47,8 +61,7 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
     msg.recipient = (Op == OP_CALL || Op == OP_STATICCALL) ? dst : state.msg->recipient;
     msg.code_address = dst;
     msg.sender = (Op == OP_DELEGATECALL) ? state.msg->sender : state.msg->recipient;
-    msg.value =
-        (Op == OP_DELEGATECALL) ? state.msg->value : intx::be::store<zvmc::uint256be>(value);
+    msg.value = (Op == OP_DELEGATECALL) ? state.msg->value : value_be;
 
     if (input_size > 0)
     {
@@ -64,7 +77,8 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
         if (has_value && state.in_static_mode())
             return {ZVMC_STATIC_MODE_VIOLATION, gas_left};
 
-        if ((has_value) && !state.host.account_exists(dst))
+        if (has_value &&
+            !(has_preflight ? preflight.account_exists : state.host.account_exists(dst)))
             cost += 25000;
     }
 
@@ -75,7 +89,8 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
     if (gas < msg.gas)
         msg.gas = static_cast<int64_t>(gas);
 
-    msg.gas = std::min(msg.gas, gas_left - gas_left / 64);
+    const auto gas_available = observed_gas_left(gas_left, state);
+    msg.gas = std::min(msg.gas, gas_available - gas_available / 64);
 
     if (has_value)
     {
@@ -86,11 +101,20 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
     if (state.msg->depth >= 1024)
         return {ZVMC_SUCCESS, gas_left};  // "Light" failure.
 
-    if (has_value && intx::be::load<uint256>(state.host.get_balance(state.msg->recipient)) < value)
+    if (has_value &&
+        !(has_preflight ?
+                preflight.balance_sufficient :
+                intx::be::load<uint256>(state.host.get_balance(state.msg->recipient)) >= value))
         return {ZVMC_SUCCESS, gas_left};  // "Light" failure.
 
-    const auto result = state.host.call(msg);
-    state.return_data.assign(result.output_data, result.output_size);
+    // The nested execution may modify the storage of this account (by the reentrancy or
+    // the delegated code). The static calls cannot modify any storage.
+    if constexpr (Op != OP_STATICCALL)
+        state.storage_cache.clear();
+
+    // The nested execution places its stack above the items of this one.
+    const StackSpace::NestedScope nested_stack_scope{state.stack_space, &stack.top()};
+    auto result = state.host.call(msg);
     stack.top() = result.status_code == ZVMC_SUCCESS;
 
     if (const auto copy_size = std::min(output_size, result.output_size); copy_size > 0)
@@ -99,6 +123,7 @@ Result call_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noexce
     const auto gas_used = msg.gas - result.gas_left;
     gas_left -= gas_used;
     state.gas_refund += result.gas_refund;
+    state.return_data = std::move(result);  // Keep the output without copying.
     return {ZVMC_SUCCESS, gas_left};
 }
 
@@ -143,12 +168,29 @@ Result create_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noex
     if (state.msg->depth >= 1024)
         return {ZVMC_SUCCESS, gas_left};  // "Light" failure.
 
-    if (endowment != 0 &&
-        intx::be::load<uint256>(state.host.get_balance(state.msg->recipient)) < endowment)
-        return {ZVMC_SUCCESS, gas_left};  // "Light" failure.
+    const auto endowment_be = intx::be::store<zvmc::uint256be>(endowment);
+    if (endowment != 0)
+    {
+        bool balance_sufficient = false;
+        if (const auto* const host_ext = state.host_extension;
+            host_ext != nullptr && host_ext->call_preflight != nullptr)
+        {
+            zvmone_call_preflight preflight{};
+            host_ext->call_preflight(
+                state.host_context, &state.msg->recipient, nullptr, &endowment_be, &preflight);
+            balance_sufficient = preflight.balance_sufficient;
+        }
+        else
+        {
+            balance_sufficient =
+                intx::be::load<uint256>(state.host.get_balance(state.msg->recipient)) >= endowment;
+        }
+        if (!balance_sufficient)
+            return {ZVMC_SUCCESS, gas_left};  // "Light" failure.
+    }
 
     auto msg = zvmc_message{};
-    msg.gas = gas_left;
+    msg.gas = observed_gas_left(gas_left, state);
     msg.gas = msg.gas - msg.gas / 64;
 
     msg.kind = (Op == OP_CREATE) ? ZVMC_CREATE : ZVMC_CREATE2;
@@ -161,15 +203,20 @@ Result create_impl(StackTop stack, int64_t gas_left, ExecutionState& state) noex
     msg.sender = state.msg->recipient;
     msg.depth = state.msg->depth + 1;
     msg.create2_salt = intx::be::store<zvmc::bytes32>(salt);
-    msg.value = intx::be::store<zvmc::uint256be>(endowment);
+    msg.value = endowment_be;
+
+    // The init code may modify the storage of this account by the reentrancy.
+    state.storage_cache.clear();
 
-    const auto result = state.host.call(msg);
+    // The nested execution places its stack above the items of this one.
+    const StackSpace::NestedScope nested_stack_scope{state.stack_space, &stack.top()};
+    auto result = state.host.call(msg);
     gas_left -= msg.gas - result.gas_left;
     state.gas_refund += result.gas_refund;
 
-    state.return_data.assign(result.output_data, result.output_size);
     if (result.status_code == ZVMC_SUCCESS)
         stack.top() = intx::be::load<uint256>(result.create_address);
+    state.return_data = std::move(result);  // Keep the output without copying.
 
     return {ZVMC_SUCCESS, gas_left};
 }
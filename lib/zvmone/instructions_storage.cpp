@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "instructions.hpp"
+#include <zvmone/zvmone.h>
 
 namespace zvmone::instr::core
 {
@@ -69,7 +70,25 @@ Result sload(StackTop stack, int64_t gas_left, ExecutionState& state) noexcept
     auto& x = stack.top();
     const auto key = intx::be::store<zvmc::bytes32>(x);
 
-    if (state.host.access_storage(state.msg->recipient, key) == ZVMC_ACCESS_COLD)
+    if (state.storage_cache.enabled())
+    {
+        // The cached slot is warm and its value is up to date.
+        if (const auto* cached = state.storage_cache.find(key); cached != nullptr)
+        {
+            x = intx::be::load<uint256>(*cached);
+            return {ZVMC_SUCCESS, gas_left};
+        }
+    }
+
+    // The host extension accesses and loads the slot with a single lookup.
+    zvmc::bytes32 value;
+    const auto access_status =
+        state.host_extension != nullptr ?
+            state.host_extension->access_and_get_storage(
+                state.host_context, &state.msg->recipient, &key, &value) :
+            state.host.access_storage(state.msg->recipient, key);
+
+    if (access_status == ZVMC_ACCESS_COLD)
     {
         // The warm storage access cost is already applied (from the cost table).
         // Here we need to apply additional cold storage access cost.
@@ -79,7 +98,11 @@ Result sload(StackTop stack, int64_t gas_left, ExecutionState& state) noexcept
             return {ZVMC_OUT_OF_GAS, gas_left};
     }
 
-    x = intx::be::load<uint256>(state.host.get_storage(state.msg->recipient, key));
+    if (state.host_extension == nullptr)
+        value = state.host.get_storage(state.msg->recipient, key);
+    if (state.storage_cache.enabled())
+        state.storage_cache.insert(key, value);
+    x = intx::be::load<uint256>(value);
 
     return {ZVMC_SUCCESS, gas_left};
 }
@@ -95,11 +118,22 @@ Result sstore(StackTop stack, int64_t gas_left, ExecutionState& state) noexcept
     const auto key = intx::be::store<zvmc::bytes32>(stack.pop());
     const auto value = intx::be::store<zvmc::bytes32>(stack.pop());
 
-    const auto gas_cost_cold =
-        (state.host.access_storage(state.msg->recipient, key) == ZVMC_ACCESS_COLD) ?
-            instr::cold_sload_cost :
-            0;
-    const auto status = state.host.set_storage(state.msg->recipient, key, value);
+    zvmc_access_status access_status;
+    zvmc_storage_status status;
+    if (state.host_extension != nullptr)
+    {
+        access_status = state.host_extension->access_and_set_storage(
+            state.host_context, &state.msg->recipient, &key, &value, &status);
+    }
+    else
+    {
+        access_status = state.host.access_storage(state.msg->recipient, key);
+        status = state.host.set_storage(state.msg->recipient, key, value);
+    }
+    if (state.storage_cache.enabled())
+        state.storage_cache.insert(key, value);
+
+    const auto gas_cost_cold = (access_status == ZVMC_ACCESS_COLD) ? instr::cold_sload_cost : 0;
 
     const auto [gas_cost_warm, gas_refund] = sstore_costs[state.rev][status];
     const auto gas_cost = gas_cost_warm + gas_cost_cold;
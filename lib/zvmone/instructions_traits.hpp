@@ -26,6 +26,9 @@ inline constexpr auto additional_cold_account_access_cost =
     cold_account_access_cost - warm_storage_read_cost;
 /// @}
 
+/// The EXP dynamic gas cost per significant byte of the exponent (EIP-160).
+inline constexpr auto exp_byte_cost = 50;
+
 
 /// The table of instruction gas costs per ZVM revision.
 using GasCostTable = std::array<std::array<int16_t, 256>, ZVMC_MAX_REVISION + 1>;
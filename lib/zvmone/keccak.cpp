@@ -0,0 +1,429 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "keccak.hpp"
+#include <intx/intx.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ZVMONE_KECCAK_X86_64 1
+#endif
+
+namespace zvmone
+{
+namespace
+{
+/// The Keccak-256 rate in bytes.
+constexpr size_t rate = 136;
+
+constexpr uint64_t round_constants[24] = {0x0000000000000001, 0x0000000000008082,
+    0x800000000000808a, 0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
+    0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
+    0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b,
+    0x8000000000008089, 0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+    0x000000000000800a, 0x800000008000000a, 0x8000000080008081, 0x8000000000008080,
+    0x0000000080000001, 0x8000000080008008};
+
+#if ZVMONE_KECCAK_X86_64
+// The vector helpers below are always inlined into the functions enabling AVX2 or AVX-512,
+// so the vector argument passing ABI does not matter.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+/// The vectors of the lanes of 4 and 8 Keccak states for the multi-buffer implementations.
+/// @{
+using u64x4 = uint64_t __attribute__((vector_size(32)));
+using u64x8 = uint64_t __attribute__((vector_size(64)));
+/// @}
+#endif
+
+/// Rotates the lane (or the vector of lanes of the multiple states) left by s in [1, 63].
+template <typename T>
+[[gnu::always_inline]] inline T rol(const T& x, int s) noexcept
+{
+    if constexpr (std::is_same_v<T, uint64_t>)
+        return std::rotl(x, s);
+    else
+        return (x << s) | (x >> (64 - s));
+}
+
+template <typename T>
+[[gnu::always_inline]] inline T andn(const T& x, const T& y) noexcept
+{
+    return ~x & y;
+}
+
+/// Computes the Keccak round without the iota step from the state a to the state e.
+///
+/// The lane (x, y) has the index x + 5 * y. The theta, rho and pi steps produce the lanes b
+/// of the output plane, which are combined by the chi step.
+/// The T is the lane or the vector of the lanes of the multiple states processed in parallel.
+template <typename T>
+[[gnu::always_inline]] inline void keccak_round(const T* a, T* e) noexcept
+{
+    const auto c0 = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20];
+    const auto c1 = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];
+    const auto c2 = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22];
+    const auto c3 = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];
+    const auto c4 = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];
+    const auto d0 = c4 ^ rol(c1, 1);
+    const auto d1 = c0 ^ rol(c2, 1);
+    const auto d2 = c1 ^ rol(c3, 1);
+    const auto d3 = c2 ^ rol(c4, 1);
+    const auto d4 = c3 ^ rol(c0, 1);
+
+    const auto b0 = a[0] ^ d0;
+    const auto b1 = rol(a[6] ^ d1, 44);
+    const auto b2 = rol(a[12] ^ d2, 43);
+    const auto b3 = rol(a[18] ^ d3, 21);
+    const auto b4 = rol(a[24] ^ d4, 14);
+    e[0] = b0 ^ andn(b1, b2);
+    e[1] = b1 ^ andn(b2, b3);
+    e[2] = b2 ^ andn(b3, b4);
+    e[3] = b3 ^ andn(b4, b0);
+    e[4] = b4 ^ andn(b0, b1);
+
+    const auto b5 = rol(a[3] ^ d3, 28);
+    const auto b6 = rol(a[9] ^ d4, 20);
+    const auto b7 = rol(a[10] ^ d0, 3);
+    const auto b8 = rol(a[16] ^ d1, 45);
+    const auto b9 = rol(a[22] ^ d2, 61);
+    e[5] = b5 ^ andn(b6, b7);
+    e[6] = b6 ^ andn(b7, b8);
+    e[7] = b7 ^ andn(b8, b9);
+    e[8] = b8 ^ andn(b9, b5);
+    e[9] = b9 ^ andn(b5, b6);
+
+    const auto b10 = rol(a[1] ^ d1, 1);
+    const auto b11 = rol(a[7] ^ d2, 6);
+    const auto b12 = rol(a[13] ^ d3, 25);
+    const auto b13 = rol(a[19] ^ d4, 8);
+    const auto b14 = rol(a[20] ^ d0, 18);
+    e[10] = b10 ^ andn(b11, b12);
+    e[11] = b11 ^ andn(b12, b13);
+    e[12] = b12 ^ andn(b13, b14);
+    e[13] = b13 ^ andn(b14, b10);
+    e[14] = b14 ^ andn(b10, b11);
+
+    const auto b15 = rol(a[4] ^ d4, 27);
+    const auto b16 = rol(a[5] ^ d0, 36);
+    const auto b17 = rol(a[11] ^ d1, 10);
+    const auto b18 = rol(a[17] ^ d2, 15);
+    const auto b19 = rol(a[23] ^ d3, 56);
+    e[15] = b15 ^ andn(b16, b17);
+    e[16] = b16 ^ andn(b17, b18);
+    e[17] = b17 ^ andn(b18, b19);
+    e[18] = b18 ^ andn(b19, b15);
+    e[19] = b19 ^ andn(b15, b16);
+
+    const auto b20 = rol(a[2] ^ d2, 62);
+    const auto b21 = rol(a[8] ^ d3, 55);
+    const auto b22 = rol(a[14] ^ d4, 39);
+    const auto b23 = rol(a[15] ^ d0, 41);
+    const auto b24 = rol(a[21] ^ d1, 2);
+    e[20] = b20 ^ andn(b21, b22);
+    e[21] = b21 ^ andn(b22, b23);
+    e[22] = b22 ^ andn(b23, b24);
+    e[23] = b23 ^ andn(b24, b20);
+    e[24] = b24 ^ andn(b20, b21);
+}
+
+template <typename T>
+[[gnu::always_inline]] inline void keccakf1600_impl(T* state) noexcept
+{
+    T a[25];
+    T e[25];
+    std::memcpy(a, state, sizeof(a));
+    for (size_t i = 0; i < std::size(round_constants); i += 2)
+    {
+        keccak_round(a, e);
+        e[0] ^= round_constants[i];
+        keccak_round(e, a);
+        a[0] ^= round_constants[i + 1];
+    }
+    std::memcpy(state, a, sizeof(a));
+}
+
+void keccakf1600_generic(uint64_t* state) noexcept
+{
+    keccakf1600_impl(state);
+}
+
+#if ZVMONE_KECCAK_X86_64
+[[gnu::target("bmi,bmi2")]] void keccakf1600_bmi(uint64_t* state) noexcept
+{
+    keccakf1600_impl(state);
+}
+#endif
+
+using PermutationFn = void (*)(uint64_t*) noexcept;
+
+PermutationFn get_permutation(KeccakBackend backend) noexcept
+{
+    switch (backend)
+    {
+#if ZVMONE_KECCAK_X86_64
+    case KeccakBackend::bmi:
+        return keccakf1600_bmi;
+#endif
+    default:
+        return keccakf1600_generic;
+    }
+}
+
+inline uint64_t load_le64(const uint8_t* data) noexcept
+{
+    uint64_t x;
+    std::memcpy(&x, data, sizeof(x));
+    if constexpr (std::endian::native == std::endian::big)
+        x = intx::bswap(x);
+    return x;
+}
+
+inline void store_le64(uint8_t* data, uint64_t x) noexcept
+{
+    if constexpr (std::endian::native == std::endian::big)
+        x = intx::bswap(x);
+    std::memcpy(data, &x, sizeof(x));
+}
+
+zvmc::bytes32 keccak256(const uint8_t* data, size_t size, PermutationFn keccakf1600) noexcept
+{
+    uint64_t state[25]{};
+
+    for (; size >= rate; data += rate, size -= rate)
+    {
+        for (size_t i = 0; i < rate / sizeof(uint64_t); ++i)
+            state[i] ^= load_le64(&data[i * sizeof(uint64_t)]);
+        keccakf1600(state);
+    }
+
+    // The last block with the padding. This is the only block of the inputs up to 135 bytes.
+    uint8_t block[rate]{};
+    if (size != 0)
+        std::memcpy(block, data, size);
+    block[size] ^= 0x01;
+    block[rate - 1] ^= 0x80;
+    for (size_t i = 0; i < rate / sizeof(uint64_t); ++i)
+        state[i] ^= load_le64(&block[i * sizeof(uint64_t)]);
+    keccakf1600(state);
+
+    zvmc::bytes32 hash;
+    for (size_t i = 0; i < sizeof(hash) / sizeof(uint64_t); ++i)
+        store_le64(&hash.bytes[i * sizeof(uint64_t)], state[i]);
+    return hash;
+}
+
+#if ZVMONE_KECCAK_X86_64
+/// Hashes up to N inputs in the parallel lanes of the vectors V.
+///
+/// The inputs are absorbed block by block. The states of the inputs having fewer blocks
+/// are still permuted, but their hashes are extracted right after their last blocks.
+template <typename V, size_t N>
+[[gnu::always_inline]] inline void keccak256_lanes(
+    const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept
+{
+    static constexpr uint8_t zero_block[rate]{};
+
+    // The number of blocks including the padding, 0 for the unused lanes.
+    size_t num_blocks[N]{};
+    size_t max_num_blocks = 0;
+    uint8_t last_blocks[N][rate]{};
+    for (size_t l = 0; l < count; ++l)
+    {
+        const auto size = inputs[l].size();
+        const auto tail_size = size % rate;
+        num_blocks[l] = size / rate + 1;
+        max_num_blocks = std::max(max_num_blocks, num_blocks[l]);
+        if (tail_size != 0)
+            std::memcpy(last_blocks[l], &inputs[l][size - tail_size], tail_size);
+        last_blocks[l][tail_size] ^= 0x01;
+        last_blocks[l][rate - 1] ^= 0x80;
+    }
+
+    V state[25]{};
+    for (size_t b = 0; b < max_num_blocks; ++b)
+    {
+        const uint8_t* blocks[N];
+        for (size_t l = 0; l < N; ++l)
+        {
+            if (b + 1 < num_blocks[l])
+                blocks[l] = &inputs[l][b * rate];
+            else if (b + 1 == num_blocks[l])
+                blocks[l] = last_blocks[l];
+            else
+                blocks[l] = zero_block;
+        }
+
+        for (size_t i = 0; i < rate / sizeof(uint64_t); ++i)
+        {
+            uint64_t words[N];
+            for (size_t l = 0; l < N; ++l)
+                words[l] = load_le64(&blocks[l][i * sizeof(uint64_t)]);
+            V v;
+            std::memcpy(&v, words, sizeof(v));
+            state[i] ^= v;
+        }
+        keccakf1600_impl(state);
+
+        for (size_t l = 0; l < count; ++l)
+        {
+            if (b + 1 == num_blocks[l])
+            {
+                for (size_t i = 0; i < sizeof(zvmc::bytes32) / sizeof(uint64_t); ++i)
+                    store_le64(&outputs[l].bytes[i * sizeof(uint64_t)], state[i][l]);
+            }
+        }
+    }
+}
+
+/// Hashes the inputs in the groups of N. The single remaining input is hashed alone
+/// with keccak256() because the multi-buffer permutation costs more than the scalar one.
+template <typename V, size_t N>
+[[gnu::always_inline]] inline void keccak256_groups(
+    const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i += N)
+    {
+        const auto group_size = std::min(count - i, N);
+        if (group_size == 1)
+            outputs[i] = zvmone::keccak256(inputs[i].data(), inputs[i].size());
+        else
+            keccak256_lanes<V, N>(&inputs[i], &outputs[i], group_size);
+    }
+}
+
+[[gnu::target("avx2")]] void keccak256_many_avx2(
+    const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept
+{
+    keccak256_groups<u64x4, 4>(inputs, outputs, count);
+}
+
+[[gnu::target("avx512f")]] void keccak256_many_avx512(
+    const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept
+{
+    keccak256_groups<u64x8, 8>(inputs, outputs, count);
+}
+#endif
+
+void keccak256_many_sequential(
+    const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; ++i)
+        outputs[i] = zvmone::keccak256(inputs[i].data(), inputs[i].size());
+}
+
+using BatchFn = void (*)(const bytes_view*, zvmc::bytes32*, size_t) noexcept;
+
+BatchFn get_batch_fn(KeccakBatchBackend backend) noexcept
+{
+    switch (backend)
+    {
+#if ZVMONE_KECCAK_X86_64
+    case KeccakBatchBackend::avx512:
+        return keccak256_many_avx512;
+    case KeccakBatchBackend::avx2:
+        return keccak256_many_avx2;
+#endif
+    default:
+        return keccak256_many_sequential;
+    }
+}
+
+KeccakBatchBackend select_batch_backend() noexcept
+{
+#if ZVMONE_KECCAK_X86_64
+    if (is_supported(KeccakBatchBackend::avx512))
+        return KeccakBatchBackend::avx512;
+    if (is_supported(KeccakBatchBackend::avx2))
+        return KeccakBatchBackend::avx2;
+#endif
+    return KeccakBatchBackend::sequential;
+}
+
+KeccakBackend select_backend() noexcept
+{
+#if ZVMONE_KECCAK_X86_64
+    if (is_supported(KeccakBackend::bmi))
+        return KeccakBackend::bmi;
+#endif
+    return KeccakBackend::generic;
+}
+}  // namespace
+
+bool is_supported(KeccakBackend backend) noexcept
+{
+    switch (backend)
+    {
+    case KeccakBackend::generic:
+        return true;
+#if ZVMONE_KECCAK_X86_64
+    case KeccakBackend::bmi:
+        return __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+#endif
+    default:
+        return false;
+    }
+}
+
+KeccakBackend get_keccak_backend() noexcept
+{
+    static const auto backend = select_backend();
+    return backend;
+}
+
+void keccakf1600(uint64_t state[25], KeccakBackend backend) noexcept
+{
+    get_permutation(backend)(state);
+}
+
+zvmc::bytes32 keccak256(const uint8_t* data, size_t size) noexcept
+{
+    static const auto permutation = get_permutation(get_keccak_backend());
+    return keccak256(data, size, permutation);
+}
+
+zvmc::bytes32 keccak256(const uint8_t* data, size_t size, KeccakBackend backend) noexcept
+{
+    return keccak256(data, size, get_permutation(backend));
+}
+
+bool is_supported(KeccakBatchBackend backend) noexcept
+{
+    switch (backend)
+    {
+    case KeccakBatchBackend::sequential:
+        return true;
+#if ZVMONE_KECCAK_X86_64
+    case KeccakBatchBackend::avx2:
+        return __builtin_cpu_supports("avx2");
+    case KeccakBatchBackend::avx512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+KeccakBatchBackend get_keccak_batch_backend() noexcept
+{
+    static const auto backend = select_batch_backend();
+    return backend;
+}
+
+void keccak256_many(const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept
+{
+    static const auto batch_fn = get_batch_fn(get_keccak_batch_backend());
+    batch_fn(inputs, outputs, count);
+}
+
+void keccak256_many(const bytes_view* inputs, zvmc::bytes32* outputs, size_t count,
+    KeccakBatchBackend backend) noexcept
+{
+    get_batch_fn(backend)(inputs, outputs, count);
+}
+}  // namespace zvmone
@@ -0,0 +1,70 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <zvmc/zvmc.hpp>
+#include <string_view>
+
+namespace zvmone
+{
+using bytes_view = std::basic_string_view<uint8_t>;
+
+/// The Keccak-f[1600] permutation implementations.
+///
+/// The permutation of a single state is a chain of dependent 64-bit operations.
+/// The AVX-512 implementation keeping the state planes in vector registers measured 2x slower
+/// than the scalar one because of the lane permutations of the rho and pi steps.
+enum class KeccakBackend
+{
+    generic,  ///< The portable implementation.
+    bmi,      ///< The portable implementation compiled for BMI1/BMI2 (ANDN, RORX).
+};
+
+/// The implementations of keccak256_many().
+enum class KeccakBatchBackend
+{
+    sequential,  ///< Hashes the inputs one by one with keccak256().
+    avx2,        ///< Hashes 4 inputs in parallel in the AVX2 vector lanes.
+    avx512,      ///< Hashes 8 inputs in parallel in the AVX-512 vector lanes.
+};
+
+/// Checks if the Keccak backend is supported by the CPU.
+ZVMC_EXPORT bool is_supported(KeccakBackend backend) noexcept;
+
+/// Checks if the Keccak batch backend is supported by the CPU.
+ZVMC_EXPORT bool is_supported(KeccakBatchBackend backend) noexcept;
+
+/// Returns the fastest Keccak backend supported by the CPU. This is used by keccak256().
+ZVMC_EXPORT KeccakBackend get_keccak_backend() noexcept;
+
+/// Applies the Keccak-f[1600] permutation to the state with the given backend.
+/// The backend must be supported.
+ZVMC_EXPORT void keccakf1600(uint64_t state[25], KeccakBackend backend) noexcept;
+
+/// Computes the Keccak-256 hash of the data.
+///
+/// The inputs of a single block (up to 135 bytes, the 136-byte rate minus the padding),
+/// like the mapping and array slot computations, take a single permutation.
+ZVMC_EXPORT zvmc::bytes32 keccak256(const uint8_t* data, size_t size) noexcept;
+
+/// Computes the Keccak-256 hash of the data with the given backend. The backend must be supported.
+ZVMC_EXPORT zvmc::bytes32 keccak256(
+    const uint8_t* data, size_t size, KeccakBackend backend) noexcept;
+
+/// Returns the fastest Keccak batch backend supported by the CPU. This is used by keccak256_many().
+ZVMC_EXPORT KeccakBatchBackend get_keccak_batch_backend() noexcept;
+
+/// Computes the Keccak-256 hashes of the count independent inputs.
+///
+/// The inputs are hashed in parallel in the SIMD vector lanes. This is most efficient
+/// for the inputs of similar sizes, like the trie keys, because the inputs are processed
+/// in groups as long as the longest input of the group.
+ZVMC_EXPORT void keccak256_many(
+    const bytes_view* inputs, zvmc::bytes32* outputs, size_t count) noexcept;
+
+/// Computes the Keccak-256 hashes of the count independent inputs with the given backend.
+/// The backend must be supported.
+ZVMC_EXPORT void keccak256_many(const bytes_view* inputs, zvmc::bytes32* outputs, size_t count,
+    KeccakBatchBackend backend) noexcept;
+}  // namespace zvmone
@@ -0,0 +1,184 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <intx/intx.hpp>
+#include <cstring>
+
+namespace zvmone
+{
+/// The modulus with the precomputed Barrett reduction constant.
+///
+/// The product of two 256-bit values is reduced with multiplications
+/// (HAC, Algorithm 14.42 with the base 2**64) instead of the 512-by-256-bit division.
+/// Only the moduli of 4 words, i.e. at least 2**192, are supported.
+class BarrettModulus
+{
+    /// The number of words of the modulus.
+    static constexpr size_t n = 4;
+
+    intx::uint256 m_modulus;
+
+    /// The Barrett constant of n+1 words: floor((2**512 - 1) / modulus).
+    /// This is floor(2**512 / modulus) except for the powers of two, where it is 1 less
+    /// and allows one more correction of the reduction result.
+    uint64_t m_mu[n + 1]{};
+
+    /// Computes the n+1 lowest words of the product of the n+1 word values.
+    static void mul_low(uint64_t* r, const uint64_t* x, const uint64_t* y) noexcept
+    {
+        std::memset(r, 0, (n + 1) * sizeof(uint64_t));
+        for (size_t i = 0; i <= n; ++i)
+        {
+            uint64_t carry = 0;
+            for (size_t j = 0; i + j <= n; ++j)
+            {
+                const auto t = intx::umul(x[i], y[j]) + r[i + j] + carry;
+                r[i + j] = t[0];
+                carry = t[1];
+            }
+        }
+    }
+
+    /// Computes the n+1 highest words of the product of the n+1 word values.
+    static void mul_high(uint64_t* r, const uint64_t* x, const uint64_t* y) noexcept
+    {
+        uint64_t p[2 * (n + 1)]{};
+        for (size_t i = 0; i <= n; ++i)
+        {
+            uint64_t carry = 0;
+            for (size_t j = 0; j <= n; ++j)
+            {
+                const auto t = intx::umul(x[i], y[j]) + p[i + j] + carry;
+                p[i + j] = t[0];
+                carry = t[1];
+            }
+            p[i + n + 1] = carry;
+        }
+        std::memcpy(r, &p[n + 1], (n + 1) * sizeof(uint64_t));
+    }
+
+    /// Checks if the n+1 word value is not less than the modulus.
+    [[nodiscard]] bool not_less_than_modulus(const uint64_t* x) const noexcept
+    {
+        if (x[n] != 0)
+            return true;
+        for (size_t i = n; i-- > 0;)
+        {
+            if (x[i] != m_modulus[i])
+                return x[i] > m_modulus[i];
+        }
+        return true;
+    }
+
+public:
+    /// Checks if the modulus is supported by the Barrett reduction.
+    static bool is_supported(const intx::uint256& modulus) noexcept { return modulus[n - 1] != 0; }
+
+    BarrettModulus() noexcept = default;
+
+    /// Precomputes the Barrett constant of the modulus. The modulus must be supported.
+    explicit BarrettModulus(const intx::uint256& modulus) noexcept : m_modulus{modulus}
+    {
+        INTX_REQUIRE(is_supported(modulus));
+
+        const auto mu = intx::udivrem(~intx::uint512{}, modulus).quot;
+        for (size_t i = 0; i <= n; ++i)
+            m_mu[i] = mu[i];
+    }
+
+    [[nodiscard]] const intx::uint256& modulus() const noexcept { return m_modulus; }
+
+    /// Computes x * y mod modulus.
+    [[nodiscard]] intx::uint256 mulmod(
+        const intx::uint256& x, const intx::uint256& y) const noexcept
+    {
+        const auto p = intx::umul(x, y);
+
+        // The estimate of the quotient q3 = floor(floor(p / b**(n-1)) * mu / b**(n+1)),
+        // which is at most 3 less than the quotient.
+        const uint64_t q1[n + 1]{p[3], p[4], p[5], p[6], p[7]};
+        uint64_t q3[n + 1];
+        mul_high(q3, q1, m_mu);
+
+        // r = (p - q3 * modulus) mod b**(n+1).
+        const uint64_t m[n + 1]{m_modulus[0], m_modulus[1], m_modulus[2], m_modulus[3], 0};
+        uint64_t q3m[n + 1];
+        mul_low(q3m, q3, m);
+        uint64_t r[n + 1];
+        bool borrow = false;
+        for (size_t i = 0; i <= n; ++i)
+        {
+            const auto d = intx::subc(p[i], q3m[i], borrow);
+            r[i] = d.value;
+            borrow = d.carry;
+        }
+
+        // At most 3 corrections.
+        while (not_less_than_modulus(r))
+        {
+            borrow = false;
+            for (size_t i = 0; i <= n; ++i)
+            {
+                const auto d = intx::subc(r[i], m[i], borrow);
+                r[i] = d.value;
+                borrow = d.carry;
+            }
+        }
+        return {r[0], r[1], r[2], r[3]};
+    }
+};
+
+
+/// The cache of the Barrett constants for the moduli of MULMOD repeated in an execution.
+///
+/// The cryptographic contracts compute MULMOD with the same few moduli repeatedly.
+/// The modulus is recorded on the first use and the Barrett constant is computed
+/// when the modulus repeats.
+class ModulusCache
+{
+    static constexpr size_t num_entries = 4;
+
+    struct Entry
+    {
+        intx::uint256 modulus;   ///< The modulus or 0 for the empty entry.
+        BarrettModulus barrett;  ///< The modulus with the Barrett constant if ready.
+        bool ready = false;      ///< Whether the Barrett constant has been computed.
+    };
+
+    Entry m_entries[num_entries]{};
+
+    /// The index of the entry to be replaced next.
+    size_t m_next = 0;
+
+public:
+    /// Returns the Barrett modulus if the modulus has been used before, otherwise records
+    /// the modulus and returns nullptr. The modulus must be supported by the Barrett reduction.
+    const BarrettModulus* find(const intx::uint256& modulus) noexcept
+    {
+        for (auto& entry : m_entries)
+        {
+            if (entry.modulus == modulus)
+            {
+                if (!entry.ready)
+                {
+                    entry.barrett = BarrettModulus{modulus};
+                    entry.ready = true;
+                }
+                return &entry.barrett;
+            }
+        }
+
+        // Record the modulus without computing the Barrett constant.
+        auto& entry = m_entries[m_next];
+        m_next = (m_next + 1) % num_entries;
+        entry.modulus = modulus;
+        entry.ready = false;
+        return nullptr;
+    }
+
+    /// Removes all entries.
+    void clear() noexcept { *this = {}; }
+};
+}  // namespace zvmone
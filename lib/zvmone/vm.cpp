@@ -9,7 +9,10 @@
 #include "advanced_execution.hpp"
 #include "baseline.hpp"
 #include <zvmone/zvmone.h>
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 
 namespace zvmone
@@ -35,6 +38,9 @@ zvmc_set_option_result set_option(zvmc_vm* c_vm, char const* c_name, char const*
 
     if (name == "advanced")
     {
+        // The Advanced interpreter does not support the unmetered execution.
+        if (vm.unmetered)
+            return ZVMC_SET_OPTION_INVALID_VALUE;
         c_vm->execute = zvmone::advanced::execute;
         return ZVMC_SET_OPTION_SUCCESS;
     }
@@ -51,6 +57,60 @@ zvmc_set_option_result set_option(zvmc_vm* c_vm, char const* c_name, char const*
         return ZVMC_SET_OPTION_INVALID_NAME;
 #endif
     }
+    else if (name == "unmetered")
+    {
+        // Explicit opt-in required: this mode is not suitable for consensus execution.
+        // Only the Baseline interpreter supports it.
+        if (value == "yes" && c_vm->execute != zvmone::advanced::execute)
+        {
+            vm.unmetered = true;
+            return ZVMC_SET_OPTION_SUCCESS;
+        }
+        return ZVMC_SET_OPTION_INVALID_VALUE;
+    }
+    else if (name == "memory")
+    {
+        if (value == "heap")
+        {
+            vm.memory_backend = Memory::Backend::heap;
+            return ZVMC_SET_OPTION_SUCCESS;
+        }
+        if (value == "virtual")
+        {
+            vm.memory_backend = Memory::Backend::virtual_memory;
+            return ZVMC_SET_OPTION_SUCCESS;
+        }
+        if (value == "arena")
+        {
+            vm.memory_backend = Memory::Backend::arena;
+            return ZVMC_SET_OPTION_SUCCESS;
+        }
+        return ZVMC_SET_OPTION_INVALID_VALUE;
+    }
+    else if (name == "shared_stack")
+    {
+        if (value == "yes" || value == "no")
+        {
+            vm.shared_stack = (value == "yes");
+            return ZVMC_SET_OPTION_SUCCESS;
+        }
+        return ZVMC_SET_OPTION_INVALID_VALUE;
+    }
+    else if (name == "storage_cache")
+    {
+        if (value == "yes" || value == "no")
+        {
+            vm.storage_cache = (value == "yes");
+            return ZVMC_SET_OPTION_SUCCESS;
+        }
+        return ZVMC_SET_OPTION_INVALID_VALUE;
+    }
+    else if (name == "cache_dir")
+    {
+        if (value.empty() || !vm.set_analysis_cache_dir(std::string{value}))
+            return ZVMC_SET_OPTION_INVALID_VALUE;
+        return ZVMC_SET_OPTION_SUCCESS;
+    }
     else if (name == "trace")
     {
         vm.add_tracer(create_instruction_tracer(std::cerr));
@@ -67,6 +127,39 @@ zvmc_set_option_result set_option(zvmc_vm* c_vm, char const* c_name, char const*
 }  // namespace
 
 
+bool VM::set_host_extension(
+    const zvmc_host_interface* host, const zvmone_host_extension* extension) noexcept
+{
+    if (host == nullptr)
+        return false;
+
+    const std::lock_guard lock{m_extended_hosts_mutex};
+
+    // Unregister the previous extension of the host.
+    ExtendedHost* slot = nullptr;
+    for (auto& e : m_extended_hosts)
+    {
+        const auto* const h = e.host.load(std::memory_order_relaxed);
+        if (h == host)
+            e.host.store(nullptr, std::memory_order_relaxed);
+        if (h == host || (h == nullptr && slot == nullptr))
+            slot = &e;
+    }
+
+    // The extension of a host built against an older header misses the newer members.
+    constexpr auto storage_fns_end = offsetof(zvmone_host_extension, call_preflight);
+    if (extension == nullptr || extension->size < storage_fns_end ||
+        extension->access_and_get_storage == nullptr ||
+        extension->access_and_set_storage == nullptr || slot == nullptr)
+        return false;
+
+    slot->extension = {};
+    std::memcpy(&slot->extension, extension, std::min(extension->size, sizeof(slot->extension)));
+    slot->extension.size = sizeof(slot->extension);
+    slot->host.store(host, std::memory_order_release);
+    return true;
+}
+
 inline constexpr VM::VM() noexcept
   : zvmc_vm{
         ZVMC_ABI_VERSION,
@@ -86,4 +179,10 @@ ZVMC_EXPORT zvmc_vm* zvmc_create_zvmone() noexcept
 {
     return new zvmone::VM{};
 }
+
+ZVMC_EXPORT bool zvmone_set_host_extension(zvmc_vm* vm, const zvmc_host_interface* host,
+    const zvmone_host_extension* extension) noexcept
+{
+    return static_cast<zvmone::VM*>(vm)->set_host_extension(host, extension);
+}
 }
@@ -3,8 +3,13 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "analysis_cache.hpp"
 #include "tracing.hpp"
 #include <zvmc/zvmc.h>
+#include <zvmone/zvmone.h>
+#include <array>
+#include <atomic>
+#include <mutex>
 
 #if defined(_MSC_VER) && !defined(__clang__)
 #define ZVMONE_CGOTO_SUPPORTED 0
@@ -20,8 +25,56 @@ class VM : public zvmc_vm
 public:
     bool cgoto = ZVMONE_CGOTO_SUPPORTED;
 
+    /// The gas-unmetered execution mode for trusted simulations (e.g. tracing replays of already
+    /// validated blocks). Base gas costs are accumulated but never checked so the execution
+    /// never runs out of gas and the reported gas used is approximate. The GAS, CALL and CREATE
+    /// instructions and the tracers observe the gas left relative to the message gas limit
+    /// (clamped at 0). The memory is limited to the size the message gas limit can pay for.
+    ///
+    /// Only the per-instruction gas checks are skipped: the base costs are still subtracted and
+    /// the dynamic gas costs are still computed, so the speedup over the metered execution is
+    /// marginal. The mode is VM-wide; use a separate VM instance for unmetered executions.
+    /// This must never be used for consensus execution. Only the Baseline interpreter supports it
+    /// so it cannot be combined with the "advanced" option.
+    bool unmetered = false;
+
+    /// The backend of the ZVM memory of new executions. The nested executions share the arena.
+    /// The virtual memory and arena backends are opt-in with the "memory" option.
+    Memory::Backend memory_backend = Memory::default_backend;
+
+    /// Whether the nested executions share the thread's stack region.
+    /// This is opt-in with the "shared_stack" option.
+    bool shared_stack = false;
+
+    /// Whether the executions cache the storage values accessed by the frame (see StorageCache).
+    bool storage_cache = false;
+
+    /// The max number of host interfaces with the host extension registered at a time.
+    static constexpr size_t max_extended_hosts = 8;
+
 private:
     std::unique_ptr<Tracer> m_first_tracer;
+    std::unique_ptr<AnalysisCache> m_analysis_cache;
+
+    /// The host interface with the copy of its registered host extension.
+    struct ExtendedHost
+    {
+        /// The host interface or null if the slot is free. Set after the extension is copied.
+        std::atomic<const zvmc_host_interface*> host = nullptr;
+
+        /// The copy of the registered host extension. The members unknown to the host are null.
+        zvmone_host_extension extension{};
+    };
+
+    /// The host extensions registered per host interface.
+    std::array<ExtendedHost, max_extended_hosts> m_extended_hosts{};
+
+    /// Serializes the registrations. The lookups are lock-free.
+    std::mutex m_extended_hosts_mutex;
+
+    /// The storage cache statistics of the finished executions.
+    std::atomic<uint64_t> m_storage_cache_hits = 0;
+    std::atomic<uint64_t> m_storage_cache_misses = 0;
 
 public:
     inline constexpr VM() noexcept;
@@ -36,5 +89,56 @@ public:
     }
 
     [[nodiscard]] Tracer* get_tracer() const noexcept { return m_first_tracer.get(); }
+
+    /// Enables the persistent code analysis cache in the given directory.
+    /// Returns false and keeps the current cache if the new one cannot be created.
+    bool set_analysis_cache_dir(std::string dir) noexcept
+    {
+        auto cache = AnalysisCache::create(std::move(dir));
+        if (!cache)
+            return false;
+        m_analysis_cache = std::move(cache);
+        return true;
+    }
+
+    /// Returns the code analysis cache or null if not enabled.
+    [[nodiscard]] AnalysisCache* get_analysis_cache() const noexcept
+    {
+        return m_analysis_cache.get();
+    }
+
+    /// Registers the host extension for the host interface (see zvmone_set_host_extension()).
+    /// The registrations of other host interfaces are not affected and may be used by
+    /// concurrent executions. Returns false if the extension has not been registered.
+    bool set_host_extension(
+        const zvmc_host_interface* host, const zvmone_host_extension* extension) noexcept;
+
+    /// Returns the host extension registered for the host interface or null.
+    [[nodiscard]] const zvmone_host_extension* get_host_extension(
+        const zvmc_host_interface* host) const noexcept
+    {
+        if (host == nullptr)
+            return nullptr;
+        for (const auto& e : m_extended_hosts)
+        {
+            if (e.host.load(std::memory_order_acquire) == host)
+                return &e.extension;
+        }
+        return nullptr;
+    }
+
+    /// Adds the storage cache statistics of the finished execution.
+    void record_storage_cache_stats(const StorageCache::Stats& stats) noexcept
+    {
+        m_storage_cache_hits.fetch_add(stats.hits, std::memory_order_relaxed);
+        m_storage_cache_misses.fetch_add(stats.misses, std::memory_order_relaxed);
+    }
+
+    /// Returns the storage cache statistics of all finished executions.
+    [[nodiscard]] StorageCache::Stats get_storage_cache_stats() const noexcept
+    {
+        return {m_storage_cache_hits.load(std::memory_order_relaxed),
+            m_storage_cache_misses.load(std::memory_order_relaxed)};
+    }
 };
 }  // namespace zvmone
@@ -274,6 +274,8 @@ int main(int argc, char** argv)
         registered_vms["advanced"] = zvmc::VM{zvmc_create_zvmone(), {{"advanced", ""}}};
         registered_vms["baseline"] = zvmc::VM{zvmc_create_zvmone()};
         registered_vms["bnocgoto"] = zvmc::VM{zvmc_create_zvmone(), {{"cgoto", "no"}}};
+        registered_vms["bvirtmem"] = zvmc::VM{zvmc_create_zvmone(), {{"memory", "virtual"}}};
+        registered_vms["bheapmem"] = zvmc::VM{zvmc_create_zvmone(), {{"memory", "heap"}}};
         register_benchmarks(benchmark_cases);
         register_synthetic_benchmarks();
         RunSpecifiedBenchmarks();
@@ -75,6 +75,27 @@ inline zvmc::Result zvmc_execute(zvmc::VM& vm, FakeExecutionState& /*exec_state*
 }
 
 
+/// Returns the number of bytes allocated by the code analysis.
+/// All the storage vectors of the analysis must be counted here.
+inline size_t get_analysis_size(const advanced::AdvancedCodeAnalysis& analysis) noexcept
+{
+    return analysis.instrs.capacity() * sizeof(analysis.instrs[0]) +
+           analysis.push_values.capacity() * sizeof(analysis.push_values[0]) +
+           analysis.jumpdest_offsets.capacity() * sizeof(analysis.jumpdest_offsets[0]) +
+           analysis.jumpdest_targets.capacity() * sizeof(analysis.jumpdest_targets[0]) +
+           analysis.jump_table.capacity() * sizeof(analysis.jump_table[0]) +
+           analysis.stack_shuffles.capacity() * sizeof(analysis.stack_shuffles[0]) +
+           analysis.folded_constants.capacity() * sizeof(analysis.folded_constants[0]) +
+           analysis.trace_info.capacity() * sizeof(analysis.trace_info[0]);
+}
+
+/// Returns the number of bytes allocated by the code analysis.
+inline size_t get_analysis_size(const baseline::CodeAnalysis& analysis) noexcept
+{
+    constexpr auto code_padding = 33;
+    return analysis.executable_code.size() + code_padding + analysis.jumpdest_map.capacity() / 8;
+}
+
 template <typename AnalysisT, AnalyseFn<AnalysisT> analyse_fn>
 inline void bench_analyse(benchmark::State& state, zvmc_revision rev, bytes_view code) noexcept
 {
@@ -86,9 +107,36 @@ inline void bench_analyse(benchmark::State& state, zvmc_revision rev, bytes_view
         bytes_analysed += code.size();
     }
 
+    // Memory used by the analysis per byte of code.
+    const auto analysis_size = get_analysis_size(analyse_fn(rev, code));
+
     using benchmark::Counter;
     state.counters["size"] = Counter(static_cast<double>(code.size()));
     state.counters["rate"] = Counter(static_cast<double>(bytes_analysed), Counter::kIsRate);
+    state.counters["mem/size"] = Counter(
+        static_cast<double>(analysis_size) / static_cast<double>(std::max(code.size(), size_t{1})));
+
+    if constexpr (std::is_same_v<AnalysisT, advanced::AdvancedCodeAnalysis>)
+    {
+        // The fraction of the instructions skipped thanks to the stack shuffles
+        // and the constant folding.
+        const auto analysis = analyse_fn(rev, code);
+        const auto& instrs = analysis.instrs;
+        auto num_skipped = size_t{0};
+        for (size_t i = 0; i < instrs.size(); ++i)
+        {
+            auto n = int32_t{1};
+            const auto index = static_cast<size_t>(instrs[i].arg.number);
+            if (instrs[i].fn == advanced::opx_shuffle)
+                n = analysis.stack_shuffles[index].num_instrs;
+            else if (instrs[i].fn == advanced::opx_push_constant)
+                n = analysis.folded_constants[index].num_instrs;
+            num_skipped += static_cast<size_t>(n - 1);
+            i += static_cast<size_t>(n - 1);
+        }
+        state.counters["instrs/reduction"] = Counter(
+            static_cast<double>(num_skipped) / static_cast<double>(instrs.size()));
+    }
 }
 
 
@@ -206,6 +206,32 @@ bytecode generate_loop_v2(const bytecode& inner_code)
            push(jumpdest_offset) + OP_JUMPI;     // jump to jumpdest_offset if counter != 0
 }
 
+/// The operands of the arithmetic instruction benchmark.
+struct ArithmeticParams
+{
+    Opcode opcode;
+    const char* width;  ///< The name of the operands' width mix.
+    uint256 x;
+    uint256 y;
+    uint256 m;  ///< The modulus of ADDMOD and MULMOD.
+};
+
+/// Generates a benchmark loop for the arithmetic instruction with the given operands.
+///
+/// The operands are obfuscated by adding the CALLVALUE (zero) so they are not constant folded.
+/// The operands stay on the stack and are duplicated for every instruction.
+bytecode generate_arithmetic_code(const ArithmeticParams& params)
+{
+    const auto opaque = [](const uint256& v) { return push(v) + OP_CALLVALUE + OP_ADD; };
+    const auto is_ternary = params.opcode == OP_ADDMOD || params.opcode == OP_MULMOD;
+    const auto n = is_ternary ? 3 : 2;
+    const auto dup = is_ternary ? OP_DUP3 : OP_DUP2;
+    // [m] y x  DUPn DUPn [DUPn] OP POP ...  POP POP [POP]
+    return generate_loop_v2((is_ternary ? opaque(params.m) : bytecode{}) + opaque(params.y) +
+                            opaque(params.x) + stack_limit * (n * dup + params.opcode + OP_POP) +
+                            n * OP_POP);
+}
+
 bytes_view generate_code(CodeParams params)
 {
     static std::map<CodeParams, bytecode> cache;
@@ -254,6 +280,28 @@ void register_synthetic_benchmarks()
             params_list.end(), {{opcode, Mode::min_stack}, {opcode, Mode::full_stack}});
 
 
+    // The operand widths of the division and modular arithmetic instructions.
+    constexpr uint256 x64{0xfedcba9876543210};
+    constexpr uint256 y64{0x12345678};
+    constexpr uint256 x128{0xfedcba9876543210, 0xfedcba9876543210};
+    constexpr uint256 y128{0xdef0123456789abc, 0x123};
+    constexpr uint256 x256{
+        0xfedcba9876543210, 0xfedcba9876543210, 0xfedcba9876543210, 0xfedcba9876543210};
+    constexpr uint256 y256{0x123456789abcdef0, 0x123456789abcdef0, 0x123456789abcdef};
+    std::vector<ArithmeticParams> arithmetic_params_list;
+    for (const auto opcode : {OP_DIV, OP_SDIV, OP_MOD, OP_SMOD, OP_ADDMOD, OP_MULMOD})
+    {
+        arithmetic_params_list.insert(arithmetic_params_list.end(),
+            {{opcode, "n64", x64, y64, y64 + 1}, {opcode, "n128", x128, y128, y128 + 1},
+                {opcode, "n256", x256, y256, y256 + 1}});
+        if (opcode == OP_SDIV || opcode == OP_SMOD)
+            arithmetic_params_list.push_back({opcode, "neg64", -(x64 / 2), y64, {}});
+    }
+    // EXP with the common bases and a generic one.
+    arithmetic_params_list.insert(arithmetic_params_list.end(),
+        {{OP_EXP, "base2", 2, 200, {}}, {OP_EXP, "base10", 10, 18, {}},
+            {OP_EXP, "n256", x256, y64, {}}});
+
     for (auto& [vm_name, vm] : registered_vms)
     {
         RegisterBenchmark(std::string{vm_name} + "/total/synth/loop_v1",
@@ -272,5 +320,17 @@ void register_synthetic_benchmarks()
                 ->Unit(kMicrosecond);
         }
     }
+
+    for (const auto& params : arithmetic_params_list)
+    {
+        for (auto& [vm_name, vm] : registered_vms)
+        {
+            RegisterBenchmark(std::string{vm_name} + "/total/synth/" +
+                                  instr::traits[params.opcode].name + '/' + params.width,
+                [&vm_ = vm, code = generate_arithmetic_code(params)](
+                    State& state) { bench_zvmc_execute(state, vm_, code); })
+                ->Unit(kMicrosecond);
+        }
+    }
 }
 }  // namespace zvmone::test
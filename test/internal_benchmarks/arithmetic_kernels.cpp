@@ -0,0 +1,122 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <benchmark/benchmark.h>
+#include <zvmone/arithmetic_kernels.hpp>
+#include <random>
+#include <vector>
+
+namespace
+{
+using intx::uint256;
+namespace kernels = zvmone::kernels;
+
+/// The number of operand pairs processed in a benchmark iteration.
+constexpr size_t num_operands = 1024;
+
+/// Generates the operands with the random number of significant words.
+std::vector<uint256> generate_operands(uint64_t seed)
+{
+    std::mt19937_64 rng{seed};
+    std::vector<uint256> operands(num_operands);
+    for (auto& x : operands)
+    {
+        const auto num_words = rng() % 4 + 1;
+        for (size_t i = 0; i < num_words; ++i)
+            x[i] = rng();
+    }
+    return operands;
+}
+
+template <typename R, R (*Op)(const uint256&, const uint256&) noexcept>
+void run_binop(benchmark::State& state, const std::vector<uint256>& y)
+{
+    state.SetLabel(kernels::isa_name);
+    const auto x = generate_operands(1);
+    for ([[maybe_unused]] auto _ : state)
+    {
+        for (size_t i = 0; i < num_operands; ++i)
+        {
+            auto r = Op(x[i], y[i]);
+            benchmark::DoNotOptimize(r);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * num_operands));
+}
+
+template <typename R, R (*Op)(const uint256&, const uint256&) noexcept>
+void binop(benchmark::State& state)
+{
+    run_binop<R, Op>(state, generate_operands(2));
+}
+
+template <bool (*Op)(const uint256&) noexcept>
+void unop(benchmark::State& state)
+{
+    state.SetLabel(kernels::isa_name);
+    auto x = generate_operands(1);
+    for (size_t i = 0; i < num_operands; i += 4)
+        x[i] = 0;
+    for ([[maybe_unused]] auto _ : state)
+    {
+        for (size_t i = 0; i < num_operands; ++i)
+        {
+            auto r = Op(x[i]);
+            benchmark::DoNotOptimize(r);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * num_operands));
+}
+
+void signextend(benchmark::State& state)
+{
+    state.SetLabel(kernels::isa_name);
+    auto x = generate_operands(1);
+    for ([[maybe_unused]] auto _ : state)
+    {
+        for (size_t i = 0; i < num_operands; ++i)
+        {
+            kernels::signextend(x[i], static_cast<unsigned>(i % 31));
+            benchmark::DoNotOptimize(x[i]);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * num_operands));
+}
+
+/// The portable intx implementations for the comparison with the kernels.
+/// @{
+uint256 intx_add(const uint256& x, const uint256& y) noexcept
+{
+    return x + y;
+}
+uint256 intx_sub(const uint256& x, const uint256& y) noexcept
+{
+    return x - y;
+}
+bool intx_lt(const uint256& x, const uint256& y) noexcept
+{
+    return x < y;
+}
+bool intx_eq(const uint256& x, const uint256& y) noexcept
+{
+    return x == y;
+}
+bool intx_is_zero(const uint256& x) noexcept
+{
+    return x == 0;
+}
+/// @}
+}  // namespace
+
+BENCHMARK_TEMPLATE(binop, uint256, kernels::add);
+BENCHMARK_TEMPLATE(binop, uint256, intx_add);
+BENCHMARK_TEMPLATE(binop, uint256, kernels::sub);
+BENCHMARK_TEMPLATE(binop, uint256, intx_sub);
+BENCHMARK_TEMPLATE(binop, bool, kernels::lt);
+BENCHMARK_TEMPLATE(binop, bool, intx_lt);
+BENCHMARK_TEMPLATE(binop, bool, kernels::eq);
+BENCHMARK_TEMPLATE(binop, bool, intx_eq);
+BENCHMARK_TEMPLATE(unop, kernels::is_zero);
+BENCHMARK_TEMPLATE(unop, intx_is_zero);
+BENCHMARK(signextend);
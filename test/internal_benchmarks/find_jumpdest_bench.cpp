@@ -6,6 +6,7 @@
 #include <array>
 #include <random>
 #include <unordered_map>
+#include <vector>
 
 #pragma GCC diagnostic error "-Wconversion"
 
@@ -308,6 +309,76 @@ void find_jumpdest_hashmap_random(benchmark::State& state)
 BENCHMARK_TEMPLATE(find_jumpdest_hashmap_random, int);
 BENCHMARK_TEMPLATE(find_jumpdest_hashmap_random, uint16_t);
 
+
+/// The dense jump table indexed by code offset (as in advanced::AdvancedCodeAnalysis).
+/// It covers all offsets up to the last jumpdest of the map_builder's map.
+template <typename T>
+struct dense_map_builder
+{
+    static const std::vector<T> map;
+};
+
+template <typename T>
+const std::vector<T> dense_map_builder<T>::map = []() {
+    auto m = std::vector<T>(2 * jumpdest_map_size, T(-1));
+    for (const auto& [offset, target] : map_builder<T>::map)
+        m[static_cast<size_t>(offset)] = target;
+    return m;
+}();
+
+template <typename T>
+inline T dense(const T* table, size_t size, T offset) noexcept
+{
+    return static_cast<size_t>(offset) < size ? table[offset] : T(-1);
+}
+
+template <typename T>
+void find_jumpdest_dense(benchmark::State& state)
+{
+    const auto& map = dense_map_builder<T>::map;
+    // The table covering the first `size` jumpdests of the map.
+    const auto size = 2 * static_cast<size_t>(state.range(0));
+    const auto needle = static_cast<T>(state.range(1));
+    benchmark::ClobberMemory();
+
+    int x = -1;
+    for (auto _ : state)
+    {
+        x = dense(map.data(), size, needle);
+        benchmark::DoNotOptimize(x);
+    }
+
+    if (needle % 2 == 1)
+    {
+        if (x != needle + 1)
+            state.SkipWithError("incorrect element found");
+    }
+    else if (x != T(-1))
+        state.SkipWithError("element should not have been found");
+}
+
+template <typename T>
+void find_jumpdest_dense_random(benchmark::State& state)
+{
+    const auto indexes = random_indexes;
+    const auto& map = dense_map_builder<T>::map;
+    benchmark::ClobberMemory();
+
+    while (state.KeepRunningBatch(indexes.size()))
+    {
+        for (auto i : indexes)
+        {
+            auto x = dense(map.data(), map.size(), static_cast<T>(i));
+            benchmark::DoNotOptimize(x);
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(find_jumpdest_dense, int) ARGS;
+BENCHMARK_TEMPLATE(find_jumpdest_dense, uint16_t) ARGS;
+BENCHMARK_TEMPLATE(find_jumpdest_dense_random, int);
+BENCHMARK_TEMPLATE(find_jumpdest_dense_random, uint16_t);
+
 }  // namespace
 
 BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <benchmark/benchmark.h>
+#include <ethash/keccak.hpp>
+#include <zvmone/keccak.hpp>
+#include <vector>
+
+namespace
+{
+using zvmone::KeccakBackend;
+using zvmone::KeccakBatchBackend;
+
+std::vector<uint8_t> generate_input(size_t size)
+{
+    std::vector<uint8_t> input(size);
+    for (size_t i = 0; i < size; ++i)
+        input[i] = static_cast<uint8_t>(i * 7 + 3);
+    return input;
+}
+
+void keccak256(benchmark::State& state, KeccakBackend backend)
+{
+    if (!zvmone::is_supported(backend))
+        return state.SkipWithError("backend not supported");
+
+    const auto input = generate_input(static_cast<size_t>(state.range(0)));
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto h = zvmone::keccak256(input.data(), input.size(), backend);
+        benchmark::DoNotOptimize(h);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+
+void keccak256_ethash(benchmark::State& state)
+{
+    const auto input = generate_input(static_cast<size_t>(state.range(0)));
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto h = ethash::keccak256(input.data(), input.size());
+        benchmark::DoNotOptimize(h);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+
+void keccakf1600(benchmark::State& state, KeccakBackend backend)
+{
+    if (!zvmone::is_supported(backend))
+        return state.SkipWithError("backend not supported");
+
+    uint64_t s[25]{};
+    for ([[maybe_unused]] auto _ : state)
+    {
+        zvmone::keccakf1600(s, backend);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+/// Hashes the number of the inputs of the given size with keccak256_many().
+void keccak256_many(benchmark::State& state, KeccakBatchBackend backend)
+{
+    if (!zvmone::is_supported(backend))
+        return state.SkipWithError("backend not supported");
+
+    const auto count = static_cast<size_t>(state.range(0));
+    const auto input = generate_input(static_cast<size_t>(state.range(1)));
+    const std::vector<zvmone::bytes_view> inputs(count, {input.data(), input.size()});
+    std::vector<zvmc::bytes32> outputs(count);
+    for ([[maybe_unused]] auto _ : state)
+    {
+        zvmone::keccak256_many(inputs.data(), outputs.data(), count, backend);
+        benchmark::DoNotOptimize(outputs.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+}  // namespace
+
+/// The input sizes: a word, the mapping slot, the single block limit, two blocks,
+/// and the code sizes up to the limit.
+#define ARGS                \
+    ->Arg(32)               \
+        ->Arg(64)           \
+        ->Arg(135)          \
+        ->Arg(136)          \
+        ->Arg(1024)         \
+        ->Arg(4096)         \
+        ->Arg(24576)
+
+BENCHMARK_CAPTURE(keccak256, generic, KeccakBackend::generic) ARGS;
+BENCHMARK_CAPTURE(keccak256, bmi, KeccakBackend::bmi) ARGS;
+BENCHMARK(keccak256_ethash) ARGS;
+BENCHMARK_CAPTURE(keccakf1600, generic, KeccakBackend::generic);
+BENCHMARK_CAPTURE(keccakf1600, bmi, KeccakBackend::bmi);
+
+#define ARGS_MANY ->ArgsProduct({{1, 3, 8, 64, 1024}, {32, 64, 600}})
+BENCHMARK_CAPTURE(keccak256_many, sequential, KeccakBatchBackend::sequential) ARGS_MANY;
+BENCHMARK_CAPTURE(keccak256_many, avx2, KeccakBatchBackend::avx2) ARGS_MANY;
+BENCHMARK_CAPTURE(keccak256_many, avx512, KeccakBatchBackend::avx512) ARGS_MANY;
@@ -0,0 +1,92 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <benchmark/benchmark.h>
+#include <zvmone/execution_state.hpp>
+
+namespace
+{
+using zvmone::Memory;
+
+/// Grows the memory word by word like the memory_grow_mstore benchmark.
+void grow_mstore(Memory& memory, size_t size) noexcept
+{
+    for (size_t offset = 0; offset < size; offset += 32)
+    {
+        memory.grow(offset + 32);
+        memory[offset] = 1;
+    }
+}
+
+/// Grows the memory word by word like the memory_grow_mload benchmark.
+void grow_mload(Memory& memory, size_t size) noexcept
+{
+    for (size_t offset = 0; offset < size; offset += 32)
+    {
+        memory.grow(offset + 32);
+        benchmark::DoNotOptimize(memory[offset]);
+    }
+}
+
+/// Grows the memory in a single expansion.
+void grow_once(Memory& memory, size_t size) noexcept
+{
+    memory.grow(size);
+    memory[size - 1] = 1;
+}
+
+template <void (*F)(Memory&, size_t) noexcept, Memory::Backend Backend>
+void memory_grow(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0)) * 1024;
+
+    for (auto _ : state)
+    {
+        Memory memory;
+        memory.set_backend(Backend);
+        F(memory, size);
+        benchmark::DoNotOptimize(memory.data());
+    }
+}
+
+/// Grows the memories of the nested executions of the given depth.
+template <Memory::Backend Backend>
+void grow_nested(int depth, size_t size) noexcept
+{
+    Memory memory;
+    memory.set_backend(Backend);
+    memory.grow(size);
+    memory[size - 1] = 1;
+    if (depth > 1)
+        grow_nested<Backend>(depth - 1, size);
+    benchmark::DoNotOptimize(memory.data());
+}
+
+template <Memory::Backend Backend>
+void memory_nested(benchmark::State& state)
+{
+    const auto depth = static_cast<int>(state.range(0));
+    const auto size = static_cast<size_t>(state.range(1)) * 1024;
+
+    for (auto _ : state)
+        grow_nested<Backend>(depth, size);
+}
+
+#define ARGS ->RangeMultiplier(4)->Range(4, 16 * 1024)
+#define NESTED_ARGS ->Args({20, 1})->Args({20, 16})->Args({100, 4})
+
+BENCHMARK_TEMPLATE(memory_grow, grow_mstore, Memory::Backend::heap) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_mstore, Memory::Backend::virtual_memory) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_mstore, Memory::Backend::arena) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_mload, Memory::Backend::heap) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_mload, Memory::Backend::virtual_memory) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_mload, Memory::Backend::arena) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_once, Memory::Backend::heap) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_once, Memory::Backend::virtual_memory) ARGS;
+BENCHMARK_TEMPLATE(memory_grow, grow_once, Memory::Backend::arena) ARGS;
+BENCHMARK_TEMPLATE(memory_nested, Memory::Backend::heap) NESTED_ARGS;
+BENCHMARK_TEMPLATE(memory_nested, Memory::Backend::virtual_memory) NESTED_ARGS;
+BENCHMARK_TEMPLATE(memory_nested, Memory::Backend::arena) NESTED_ARGS;
+
+}  // namespace
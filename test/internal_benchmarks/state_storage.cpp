@@ -0,0 +1,177 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <benchmark/benchmark.h>
+#include <test/state/mpt_hash.hpp>
+#include <test/state/state.hpp>
+#include <test/utils/bytecode.hpp>
+#include <zvmone/zvmone.h>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+using namespace zvmone;
+using state::StorageValue;
+
+/// The number of lookups in a benchmark iteration.
+constexpr size_t num_lookups = 1024;
+
+std::vector<bytes32> generate_keys(size_t count, uint64_t seed)
+{
+    std::mt19937_64 rng{seed};
+    std::vector<bytes32> keys(count);
+    for (auto& key : keys)
+    {
+        for (size_t i = 0; i < sizeof(key); i += sizeof(uint64_t))
+        {
+            const auto w = rng();
+            std::memcpy(&key.bytes[i], &w, sizeof(w));
+        }
+    }
+    return keys;
+}
+
+template <typename Map>
+void storage_find(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    const auto keys = generate_keys(size, 1);
+    Map storage;
+    for (const auto& key : keys)
+        storage[key] = {.current = key, .original = key};
+
+    std::mt19937_64 rng{2};
+    std::vector<bytes32> lookups(num_lookups);
+    for (auto& key : lookups)
+        key = keys[rng() % size];
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        for (const auto& key : lookups)
+        {
+            auto it = storage.find(key);
+            benchmark::DoNotOptimize(it);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * num_lookups));
+}
+
+template <typename Map>
+void storage_insert(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    const auto keys = generate_keys(size, 1);
+    for ([[maybe_unused]] auto _ : state)
+    {
+        Map storage;
+        for (const auto& key : keys)
+            storage.try_emplace(key);
+        benchmark::DoNotOptimize(storage);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+
+/// Creates the accounts with the storage sizes typical for the state: most have no storage,
+/// the rest have up to 4 slots.
+state::AccountMap generate_accounts(size_t count)
+{
+    std::mt19937_64 rng{3};
+    state::AccountMap accounts;
+    for (size_t i = 0; i < count; ++i)
+    {
+        address addr;
+        const auto w = rng();
+        std::memcpy(addr.bytes, &w, sizeof(w));
+        auto& acc = accounts[addr];
+        acc.nonce = 1;
+        const auto num_slots = i % 8 < 5 ? 0 : rng() % 5;
+        for (uint64_t j = 0; j < num_slots; ++j)
+            acc.storage[bytes32{j}] = {.current = bytes32{j + 1}, .original = bytes32{j + 1}};
+    }
+    return accounts;
+}
+
+void state_copy(benchmark::State& state)
+{
+    const auto accounts = generate_accounts(static_cast<size_t>(state.range(0)));
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto copy = accounts;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * accounts.size()));
+}
+
+void state_mpt_hash(benchmark::State& state)
+{
+    const auto accounts = generate_accounts(static_cast<size_t>(state.range(0)));
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto hash = state::mpt_hash(accounts);
+        benchmark::DoNotOptimize(hash);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * accounts.size()));
+}
+
+/// Executes the transactions doing SLOAD and SSTORE of 1000 slots of the account
+/// with the storage of the given size.
+void sload_sstore_transition(benchmark::State& state)
+{
+    static constexpr auto Sender = "Z5e4d00000000000000000000000000000000d4e5"_address;
+    static constexpr auto To = "Zc0de"_address;
+    static constexpr uint64_t num_accesses = 1000;
+
+    // storage[i] += 1 for i in [num_accesses, 1].
+    const auto loop_begin = push(num_accesses);
+    const auto code = loop_begin + OP_JUMPDEST + OP_DUP1 + OP_SLOAD + push(1) + OP_ADD + OP_DUP2 +
+                      OP_SSTORE + push(1) + OP_SWAP1 + OP_SUB + OP_DUP1 +
+                      push(loop_begin.size()) + OP_JUMPI;
+
+    const auto size = static_cast<uint64_t>(state.range(0));
+    state::State st;
+    st.insert(Sender, {.balance = std::numeric_limits<intx::uint256>::max() / 2});
+    auto& storage = st.insert(To, {.code = code}).storage;
+    storage.reserve(size);
+    for (uint64_t i = 0; i < size; ++i)
+    {
+        const auto value = bytes32{i + 1};
+        storage.try_emplace(bytes32{i}, StorageValue{.current = value, .original = value});
+    }
+
+    const state::BlockInfo block{.gas_limit = 30'000'000, .coinbase = "Zc014ba5e"_address};
+    const state::Transaction tx{.gas_limit = block.gas_limit,
+        .max_gas_price = 1,
+        .max_priority_gas_price = 0,
+        .sender = Sender,
+        .to = To};
+    zvmc::VM vm{zvmc_create_zvmone()};
+    state::register_host_extension(vm);
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        auto res = state::transition(st, block, tx, ZVMC_SHANGHAI, vm);
+        if (const auto* r = std::get_if<state::TransactionReceipt>(&res);
+            r == nullptr || r->status != ZVMC_SUCCESS)
+        {
+            state.SkipWithError("transaction failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * num_accesses));
+}
+
+#define ARGS Arg(100'000)->Arg(1'000'000)
+}  // namespace
+
+BENCHMARK_TEMPLATE(storage_find, std::unordered_map<bytes32, StorageValue>)->ARGS;
+BENCHMARK_TEMPLATE(storage_find, state::StorageMap)->ARGS;
+BENCHMARK_TEMPLATE(storage_insert, std::unordered_map<bytes32, StorageValue>)->ARGS;
+BENCHMARK_TEMPLATE(storage_insert, state::StorageMap)->ARGS;
+BENCHMARK(sload_sstore_transition)->ARGS;
+BENCHMARK(state_copy)->Arg(100'000);
+BENCHMARK(state_mpt_hash)->Arg(100'000);
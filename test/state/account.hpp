@@ -3,9 +3,14 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "flat_hash_map.hpp"
+#include "hash_utils.hpp"
 #include <intx/intx.hpp>
 #include <zvmc/zvmc.hpp>
-#include <unordered_map>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
 
 namespace zvmone::state
 {
@@ -25,6 +30,114 @@ struct StorageValue
     zvmc_access_status access_status = ZVMC_ACCESS_COLD;
 };
 
+/// The account storage map.
+using StorageMap = FlatHashMap<bytes32, StorageValue>;
+
+/// The immutable account code.
+///
+/// The code buffer is reference-counted. It is shared by the copies of the account
+/// (e.g. the copies of the pre-state made by the test runners) and by the accounts with
+/// identical code (see State::share_code()). The code hash is cached in the buffer.
+/// The buffer may be shared by the states used in different threads so the hash is computed
+/// or set at most once.
+class Code
+{
+    struct Buffer
+    {
+        bytes code;
+        mutable std::once_flag hash_flag;
+        mutable std::atomic<bool> has_hash = false;
+        mutable bytes32 hash;
+
+        explicit Buffer(bytes c) noexcept : code{std::move(c)} {}
+
+        Buffer(bytes c, const bytes32& code_hash) noexcept
+          : code{std::move(c)}, has_hash{true}, hash{code_hash}
+        {
+            std::call_once(hash_flag, [] {});  // Make the hash immutable.
+        }
+
+        /// Sets the hash unless it has already been set.
+        template <typename F>
+        void set_hash_once(F compute_hash) const
+        {
+            std::call_once(hash_flag, [&] {
+                hash = compute_hash();
+                has_hash.store(true, std::memory_order_release);
+            });
+        }
+    };
+
+    /// The code buffer. Null for empty code.
+    std::shared_ptr<const Buffer> m_buffer;
+
+public:
+    /// The hash of the empty code.
+    static constexpr auto empty_hash =
+        0xc5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470_bytes32;
+
+    Code() = default;
+
+    /// Creates the code buffer. The code hash is computed on demand.
+    Code(bytes code)  // NOLINT(google-explicit-constructor)
+      : m_buffer{code.empty() ? nullptr : std::make_shared<const Buffer>(std::move(code))}
+    {}
+
+    /// Creates the code buffer with the known code hash.
+    Code(bytes_view code, const bytes32& code_hash)
+      : m_buffer{code.empty() ? nullptr : std::make_shared<const Buffer>(bytes{code}, code_hash)}
+    {}
+
+    [[nodiscard]] const uint8_t* data() const noexcept
+    {
+        return m_buffer != nullptr ? m_buffer->code.data() : nullptr;
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return m_buffer != nullptr ? m_buffer->code.size() : 0;
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return m_buffer == nullptr; }
+
+    operator bytes_view() const noexcept { return {data(), size()}; }  // NOLINT
+
+    /// Returns the code hash. The hash is computed once per code buffer.
+    [[nodiscard]] const bytes32& hash() const noexcept
+    {
+        if (m_buffer == nullptr)
+            return empty_hash;
+        if (!m_buffer->has_hash.load(std::memory_order_acquire))
+            m_buffer->set_hash_once([this] { return keccak256(m_buffer->code); });
+        return m_buffer->hash;
+    }
+
+    /// Checks if the code hash has been computed.
+    [[nodiscard]] bool has_hash() const noexcept
+    {
+        return m_buffer == nullptr || m_buffer->has_hash.load(std::memory_order_acquire);
+    }
+
+    /// Caches the code hash computed by the caller, e.g. in a batch with other codes.
+    /// The hash already computed or set by another user of the buffer is kept.
+    void set_hash(const bytes32& code_hash) const noexcept
+    {
+        assert(m_buffer != nullptr);
+        m_buffer->set_hash_once([&] { return code_hash; });
+    }
+
+    /// Checks if the codes share the same code buffer.
+    [[nodiscard]] bool shares_buffer(const Code& other) const noexcept
+    {
+        return m_buffer == other.m_buffer;
+    }
+
+    /// Checks if this is the only user of the code buffer.
+    [[nodiscard]] bool is_unique() const noexcept { return m_buffer.use_count() == 1; }
+
+    friend bool operator==(const Code& a, bytes_view b) noexcept { return bytes_view{a} == b; }
+};
+
 /// The state account.
 struct Account
 {
@@ -38,10 +151,10 @@ struct Account
     intx::uint256 balance = {};
 
     /// The account storage map.
-    std::unordered_map<bytes32, StorageValue> storage = {};
+    StorageMap storage = {};
 
     /// The account code.
-    bytes code = {};
+    Code code = {};
 
     /// The account has been destructed and should be erased at the end of of a transaction.
     bool destructed = false;
@@ -57,5 +170,15 @@ struct Account
     {
         return code.empty() && nonce == 0 && balance == 0;
     }
+
+    /// Returns the hash of the code.
+    [[nodiscard]] const bytes32& code_hash() const noexcept { return code.hash(); }
 };
+
+/// The map of the state accounts.
+///
+/// The accounts are allocated separately so the references to them are not invalidated
+/// by the insertions of other accounts (the Host keeps the references to the accounts
+/// during the nested calls).
+using AccountMap = FlatHashMap<address, Account, KeyHash, true>;
 }  // namespace zvmone::state
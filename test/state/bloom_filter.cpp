@@ -10,13 +10,11 @@ namespace zvmone::state
 
 namespace
 {
-/// Adds an entry to the bloom filter.
+/// Adds an entry to the bloom filter by the Keccak hash of the entry.
 /// based on
 /// https://ethereum.github.io/execution-specs/autoapi/ethereum/shanghai/bloom/index.html#add-to-bloom
-inline void add_to(BloomFilter& bf, const bytes_view& entry)
+inline void add_to(BloomFilter& bf, const hash256& hash)
 {
-    const auto hash = keccak256(entry);
-
     // take the least significant 11-bits of the first three 16-bit values
     for (const auto i : {0, 2, 4})
     {
@@ -32,13 +30,20 @@ inline void add_to(BloomFilter& bf, const bytes_view& entry)
 
 BloomFilter compute_bloom_filter(std::span<const Log> logs) noexcept
 {
-    BloomFilter res;
+    // Hash all the entries (the addresses and the topics) together.
+    std::vector<bytes_view> entries;
     for (const auto& log : logs)
     {
-        add_to(res, log.addr);
+        entries.emplace_back(log.addr);
         for (const auto& topic : log.topics)
-            add_to(res, topic);
+            entries.emplace_back(topic);
     }
+    std::vector<hash256> hashes(entries.size());
+    keccak256_many(entries, hashes);
+
+    BloomFilter res;
+    for (const auto& hash : hashes)
+        add_to(res, hash);
 
     return res;
 }
@@ -0,0 +1,611 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <intx/intx.hpp>
+#include <zvmc/zvmc.hpp>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace zvmone::state
+{
+/// The fast non-cryptographic hash of the addresses and the storage keys.
+///
+/// The keys are often not random (e.g. the small storage slot numbers), so the words
+/// are mixed with the 64x64->128 multiplication folded to 64 bits (as in wyhash).
+struct KeyHash
+{
+    static uint64_t mix(uint64_t x, uint64_t y) noexcept
+    {
+        const auto p = intx::umul(x, y);
+        return p[0] ^ p[1];
+    }
+
+    static uint64_t load64(const uint8_t* p) noexcept
+    {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+    static uint32_t load32(const uint8_t* p) noexcept
+    {
+        uint32_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+    size_t operator()(const zvmc::address& a) const noexcept
+    {
+        return mix(load64(&a.bytes[0]) ^ 0xa0761d6478bd642f,
+            load64(&a.bytes[8]) ^ load32(&a.bytes[16]) ^ 0xe7037ed1a0b428db);
+    }
+
+    size_t operator()(const zvmc::bytes32& k) const noexcept
+    {
+        return mix(load64(&k.bytes[0]) ^ load64(&k.bytes[16]) ^ 0xa0761d6478bd642f,
+            load64(&k.bytes[8]) ^ load64(&k.bytes[24]) ^ 0xe7037ed1a0b428db);
+    }
+};
+
+/// The hash map with open addressing.
+///
+/// The entries are kept in a single array of slots. An array of control bytes (one per slot)
+/// stores the 7 bits of the key hash of the full slots or marks the slot as empty or deleted.
+/// A lookup compares the control bytes of a group of 16 slots at once (with SSE2)
+/// and compares the keys only for the matching hash bits.
+///
+/// The capacity starts at 2 slots. The small tables (up to 8 slots) fit in a single group,
+/// so they work as small vectors searched with a single SIMD comparison. Most accounts
+/// have no or a few storage slots and their storage takes a few hundred bytes.
+///
+/// If StableValues is true, the entries are allocated separately and the slots only point to
+/// them, so the references to the entries are not invalidated by the insertions.
+/// Otherwise, the entries are stored in the slots and move when the map grows.
+/// In both cases, erasing an entry invalidates only the references to this entry.
+///
+/// The interface is a subset of the std::unordered_map interface.
+template <typename Key, typename T, typename Hash = KeyHash, bool StableValues = false>
+class FlatHashMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = size_t;
+
+private:
+    using ctrl_t = int8_t;
+    using slot_type = std::conditional_t<StableValues, value_type*, value_type>;
+
+    static constexpr size_t GroupSize = 16;
+    static constexpr size_t MinCapacity = 2;
+    static constexpr ctrl_t Empty = -128;
+    static constexpr ctrl_t Deleted = -2;
+
+    /// The group of control bytes.
+    class Group
+    {
+#if defined(__SSE2__)
+        __m128i m_ctrl;
+
+    public:
+        explicit Group(const ctrl_t* ctrl) noexcept
+          : m_ctrl{_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))}
+        {}
+
+        /// Returns the bitmask of the slots with the given control byte.
+        [[nodiscard]] uint32_t match(ctrl_t h2) const noexcept
+        {
+            return static_cast<uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl)));
+        }
+
+        /// Returns the bitmask of the empty or deleted slots (the control byte's sign bit set).
+        [[nodiscard]] uint32_t match_non_full() const noexcept
+        {
+            return static_cast<uint32_t>(_mm_movemask_epi8(m_ctrl));
+        }
+#else
+        const ctrl_t* m_ctrl;
+
+    public:
+        explicit Group(const ctrl_t* ctrl) noexcept : m_ctrl{ctrl} {}
+
+        [[nodiscard]] uint32_t match(ctrl_t h2) const noexcept
+        {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GroupSize; ++i)
+                mask |= uint32_t{m_ctrl[i] == h2} << i;
+            return mask;
+        }
+
+        [[nodiscard]] uint32_t match_non_full() const noexcept
+        {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GroupSize; ++i)
+                mask |= uint32_t{m_ctrl[i] < 0} << i;
+            return mask;
+        }
+#endif
+
+        [[nodiscard]] uint32_t match_empty() const noexcept { return match(Empty); }
+    };
+
+    /// The control bytes. The first GroupSize bytes (or all of the smaller table) are mirrored
+    /// at the end so the group starting at any slot can be loaded. In the smaller tables,
+    /// the bytes after the mirrored ones stay empty.
+    std::unique_ptr<ctrl_t[]> m_ctrl;
+
+    /// The slots. Only the slots with the full control bytes are constructed.
+    slot_type* m_slots = nullptr;
+
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+
+    /// The number of the empty slots which can be filled before the map must grow.
+    size_t m_growth_left = 0;
+
+    static constexpr size_t max_load(size_t capacity) noexcept
+    {
+        if (capacity == 0)
+            return 0;
+        // The tables smaller than a group must keep an empty slot to end the lookups.
+        if (capacity < GroupSize)
+            return capacity - 1;
+        return capacity - capacity / 8;
+    }
+
+    static constexpr bool is_full(ctrl_t c) noexcept { return c >= 0; }
+
+    static constexpr ctrl_t h2(size_t hash) noexcept { return static_cast<ctrl_t>(hash & 0x7f); }
+
+    static constexpr size_t h1(size_t hash) noexcept { return hash >> 7; }
+
+    static value_type& get(slot_type& slot) noexcept
+    {
+        if constexpr (StableValues)
+            return *slot;
+        else
+            return slot;
+    }
+
+    static const value_type& get(const slot_type& slot) noexcept
+    {
+        if constexpr (StableValues)
+            return *slot;
+        else
+            return slot;
+    }
+
+    void set_ctrl(size_t i, ctrl_t c) noexcept
+    {
+        m_ctrl[i] = c;
+        if (i < GroupSize)
+            m_ctrl[m_capacity + i] = c;
+    }
+
+    /// Returns the index of the slot with the key or m_capacity if not found.
+    [[nodiscard]] size_t find_index(const Key& key, size_t hash) const noexcept
+    {
+        if (m_capacity == 0)
+            return 0;
+
+        const auto mask = m_capacity - 1;
+        auto pos = h1(hash) & mask;
+        // Triangular probing over the groups visits all of them for the power of 2 capacity.
+        for (size_t step = GroupSize;; step += GroupSize)
+        {
+            const Group g{&m_ctrl[pos]};
+            for (auto bits = g.match(h2(hash)); bits != 0; bits &= bits - 1)
+            {
+                const auto i = (pos + static_cast<size_t>(std::countr_zero(bits))) & mask;
+                if (get(m_slots[i]).first == key) [[likely]]
+                    return i;
+            }
+            if (g.match_empty() != 0)
+                return m_capacity;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    /// Returns the index of the first empty or deleted slot in the probe sequence of the hash.
+    [[nodiscard]] size_t find_non_full(size_t hash) const noexcept
+    {
+        const auto mask = m_capacity - 1;
+        auto pos = h1(hash) & mask;
+        for (size_t step = GroupSize;; step += GroupSize)
+        {
+            if (const auto bits = Group{&m_ctrl[pos]}.match_non_full(); bits != 0)
+                return (pos + static_cast<size_t>(std::countr_zero(bits))) & mask;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    static slot_type* allocate_slots(size_t capacity)
+    {
+        return static_cast<slot_type*>(
+            ::operator new(capacity * sizeof(slot_type), std::align_val_t{alignof(slot_type)}));
+    }
+
+    static void deallocate_slots(slot_type* slots) noexcept
+    {
+        ::operator delete(slots, std::align_val_t{alignof(slot_type)});
+    }
+
+    /// Allocates the empty table of the given capacity (a power of 2 or 0).
+    void init(size_t capacity)
+    {
+        m_capacity = capacity;
+        m_size = 0;
+        m_growth_left = max_load(capacity);
+        if (capacity == 0)
+            return;
+        m_ctrl = std::make_unique_for_overwrite<ctrl_t[]>(capacity + GroupSize);
+        std::memset(m_ctrl.get(), static_cast<uint8_t>(Empty), capacity + GroupSize);
+        m_slots = allocate_slots(capacity);
+    }
+
+    void destroy() noexcept
+    {
+        if (m_slots == nullptr)
+            return;
+        for (size_t i = 0; i < m_capacity; ++i)
+        {
+            if (is_full(m_ctrl[i]))
+            {
+                if constexpr (StableValues)
+                    delete m_slots[i];
+                else
+                    std::destroy_at(&m_slots[i]);
+            }
+        }
+        deallocate_slots(m_slots);
+        m_slots = nullptr;
+        m_ctrl.reset();
+    }
+
+    /// Moves the entries to the new table of the given capacity.
+    /// This also removes the deleted control bytes.
+    void rehash(size_t new_capacity)
+    {
+        auto old_ctrl = std::move(m_ctrl);
+        auto* const old_slots = m_slots;
+        const auto old_capacity = m_capacity;
+        const auto size = m_size;
+
+        init(new_capacity);
+        for (size_t i = 0; i < old_capacity; ++i)
+        {
+            if (!is_full(old_ctrl[i]))
+                continue;
+            const auto hash = Hash{}(get(old_slots[i]).first);
+            const auto j = find_non_full(hash);
+            set_ctrl(j, h2(hash));
+            if constexpr (StableValues)
+                m_slots[j] = old_slots[i];
+            else
+            {
+                std::construct_at(&m_slots[j], std::move(old_slots[i]));
+                std::destroy_at(&old_slots[i]);
+            }
+        }
+        m_size = size;
+        m_growth_left -= size;
+        if (old_slots != nullptr)
+            deallocate_slots(old_slots);
+    }
+
+    /// Returns the index of the slot with the key and true if the key has been inserted.
+    /// The slot of the inserted key must be constructed by the caller.
+    std::pair<size_t, bool> find_or_prepare_insert(const Key& key)
+    {
+        const auto hash = Hash{}(key);
+        if (const auto i = find_index(key, hash); i != m_capacity)
+            return {i, false};
+
+        auto i = m_capacity != 0 ? find_non_full(hash) : 0;
+        if (m_capacity == 0 || (m_growth_left == 0 && m_ctrl[i] == Empty))
+        {
+            // Grow if the map is more than half full. Otherwise, only remove the deleted entries.
+            const auto new_capacity =
+                m_size + 1 > max_load(m_capacity) / 2 ? std::max(m_capacity * 2, MinCapacity) :
+                                                        m_capacity;
+            rehash(new_capacity);
+            i = find_non_full(hash);
+        }
+
+        if (m_ctrl[i] == Empty)
+            --m_growth_left;
+        set_ctrl(i, h2(hash));
+        ++m_size;
+        return {i, true};
+    }
+
+    template <typename... Args>
+    void construct(size_t i, Args&&... args)
+    {
+        if constexpr (StableValues)
+            m_slots[i] = new value_type(std::forward<Args>(args)...);
+        else
+            std::construct_at(&m_slots[i], std::forward<Args>(args)...);
+    }
+
+    void erase_index(size_t i) noexcept
+    {
+        if constexpr (StableValues)
+            delete m_slots[i];
+        else
+            std::destroy_at(&m_slots[i]);
+        // The slot can become empty again if the probe sequences never passed its group full.
+        // For simplicity, it is always marked deleted and cleaned by the next rehash.
+        set_ctrl(i, Deleted);
+        --m_size;
+    }
+
+    void copy_from(const FlatHashMap& other)
+    {
+        init(other.m_capacity);
+        if (other.m_capacity == 0)
+            return;
+        // The same capacity and hash function: the entries are copied to the same slots.
+        std::memcpy(m_ctrl.get(), other.m_ctrl.get(), m_capacity + GroupSize);
+        for (size_t i = 0; i < m_capacity; ++i)
+        {
+            if (is_full(m_ctrl[i]))
+                construct(i, get(other.m_slots[i]));
+        }
+        m_size = other.m_size;
+        m_growth_left = other.m_growth_left;
+    }
+
+    void move_from(FlatHashMap& other) noexcept
+    {
+        m_ctrl = std::move(other.m_ctrl);
+        m_slots = std::exchange(other.m_slots, nullptr);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_size = std::exchange(other.m_size, 0);
+        m_growth_left = std::exchange(other.m_growth_left, 0);
+    }
+
+    template <bool Const>
+    class Iterator
+    {
+        friend class FlatHashMap;
+        friend class Iterator<!Const>;
+
+        using map_slot_type = std::conditional_t<Const, const slot_type, slot_type>;
+
+        const ctrl_t* m_ctrl = nullptr;
+        const ctrl_t* m_ctrl_end = nullptr;
+        map_slot_type* m_slot = nullptr;
+
+        Iterator(const ctrl_t* ctrl, const ctrl_t* ctrl_end, map_slot_type* slot) noexcept
+          : m_ctrl{ctrl}, m_ctrl_end{ctrl_end}, m_slot{slot}
+        {}
+
+        void skip_non_full() noexcept
+        {
+            while (m_ctrl != m_ctrl_end && !is_full(*m_ctrl))
+            {
+                ++m_ctrl;
+                ++m_slot;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+
+        /// The iterator can be converted to the const_iterator.
+        operator Iterator<true>() const noexcept  // NOLINT(google-explicit-constructor)
+            requires(!Const)
+        {
+            return {m_ctrl, m_ctrl_end, m_slot};
+        }
+
+        reference operator*() const noexcept { return get(*m_slot); }
+
+        pointer operator->() const noexcept { return &get(*m_slot); }
+
+        Iterator& operator++() noexcept
+        {
+            ++m_ctrl;
+            ++m_slot;
+            skip_non_full();
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) noexcept
+        {
+            return a.m_ctrl == b.m_ctrl;
+        }
+    };
+
+    template <bool Const>
+    Iterator<Const> make_iterator(size_t i) const noexcept
+    {
+        using map_slot_type = typename Iterator<Const>::map_slot_type;
+        return {
+            m_ctrl.get() + i, m_ctrl.get() + m_capacity, const_cast<map_slot_type*>(m_slots + i)};
+    }
+
+public:
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() noexcept = default;
+
+    FlatHashMap(std::initializer_list<value_type> init)
+    {
+        reserve(init.size());
+        for (const auto& v : init)
+            insert(v);
+    }
+
+    FlatHashMap(const FlatHashMap& other) { copy_from(other); }
+
+    FlatHashMap(FlatHashMap&& other) noexcept { move_from(other); }
+
+    FlatHashMap& operator=(const FlatHashMap& other)
+    {
+        if (this != &other)
+        {
+            destroy();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    FlatHashMap& operator=(FlatHashMap&& other) noexcept
+    {
+        if (this != &other)
+        {
+            destroy();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    ~FlatHashMap() noexcept { destroy(); }
+
+    [[nodiscard]] size_t size() const noexcept { return m_size; }
+
+    [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+
+    [[nodiscard]] iterator begin() noexcept
+    {
+        auto it = make_iterator<false>(0);
+        it.skip_non_full();
+        return it;
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept
+    {
+        auto it = make_iterator<true>(0);
+        it.skip_non_full();
+        return it;
+    }
+
+    [[nodiscard]] iterator end() noexcept { return make_iterator<false>(m_capacity); }
+
+    [[nodiscard]] const_iterator end() const noexcept { return make_iterator<true>(m_capacity); }
+
+    [[nodiscard]] iterator find(const Key& key) noexcept
+    {
+        return make_iterator<false>(find_index(key, Hash{}(key)));
+    }
+
+    [[nodiscard]] const_iterator find(const Key& key) const noexcept
+    {
+        return make_iterator<true>(find_index(key, Hash{}(key)));
+    }
+
+    [[nodiscard]] bool contains(const Key& key) const noexcept
+    {
+        return find_index(key, Hash{}(key)) != m_capacity;
+    }
+
+    [[nodiscard]] size_t count(const Key& key) const noexcept { return contains(key) ? 1 : 0; }
+
+    [[nodiscard]] T& at(const Key& key) noexcept
+    {
+        const auto i = find_index(key, Hash{}(key));
+        assert(i != m_capacity);
+        return get(m_slots[i]).second;
+    }
+
+    [[nodiscard]] const T& at(const Key& key) const noexcept
+    {
+        const auto i = find_index(key, Hash{}(key));
+        assert(i != m_capacity);
+        return get(m_slots[i]).second;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+    {
+        const auto [i, inserted] = find_or_prepare_insert(key);
+        if (inserted)
+        {
+            construct(i, std::piecewise_construct, std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+        return {make_iterator<false>(i), inserted};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        return try_emplace(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        return try_emplace(value.first, std::move(value.second));
+    }
+
+    T& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    size_t erase(const Key& key) noexcept
+    {
+        const auto i = find_index(key, Hash{}(key));
+        if (i == m_capacity)
+            return 0;
+        erase_index(i);
+        return 1;
+    }
+
+    void clear() noexcept
+    {
+        destroy();
+        init(0);
+    }
+
+    /// Reserves the space for at least the count entries without growing.
+    void reserve(size_t count)
+    {
+        auto capacity = MinCapacity;
+        while (max_load(capacity) < count)
+            capacity *= 2;
+        if (capacity > m_capacity)
+            rehash(capacity);
+    }
+
+    /// Erases the entries satisfying the predicate. Returns the number of erased entries.
+    template <typename Predicate>
+    friend size_t erase_if(FlatHashMap& map, Predicate pred)
+    {
+        const auto old_size = map.m_size;
+        for (size_t i = 0; i < map.m_capacity; ++i)
+        {
+            if (is_full(map.m_ctrl[i]) && pred(std::as_const(get(map.m_slots[i]))))
+                map.erase_index(i);
+        }
+        return old_size - map.m_size;
+    }
+};
+}  // namespace zvmone::state
@@ -2,6 +2,22 @@
 // Copyright 2023 The evmone Authors.
 // SPDX-License-Identifier: Apache-2.0
 #include "hash_utils.hpp"
+#include <zvmone/keccak.hpp>
+#include <cassert>
+
+namespace zvmone
+{
+hash256 keccak256(bytes_view data) noexcept
+{
+    return keccak256(data.data(), data.size());
+}
+
+void keccak256_many(std::span<const bytes_view> inputs, std::span<hash256> outputs) noexcept
+{
+    assert(inputs.size() == outputs.size());
+    keccak256_many(inputs.data(), outputs.data(), inputs.size());
+}
+}  // namespace zvmone
 
 std::ostream& operator<<(std::ostream& out, const zvmone::address& a)
 {
@@ -4,10 +4,10 @@
 
 #pragma once
 
-#include <ethash/keccak.hpp>
 #include <zvmc/hex.hpp>
 #include <zvmc/zvmc.hpp>
 #include <cstring>
+#include <span>
 
 namespace zvmone
 {
@@ -22,14 +22,12 @@ using namespace zvmc::literals;
 /// Better than ethash::hash256 because has some additional handy constructors.
 using hash256 = bytes32;
 
-/// Computes Keccak hash out of input bytes (wrapper of ethash::keccak256).
-inline hash256 keccak256(bytes_view data) noexcept
-{
-    const auto eh = ethash::keccak256(data.data(), data.size());
-    hash256 h;
-    std::memcpy(h.bytes, eh.bytes, sizeof(h));  // TODO: Use std::bit_cast.
-    return h;
-}
+/// Computes Keccak hash out of input bytes (with the zvmone Keccak implementation).
+hash256 keccak256(bytes_view data) noexcept;
+
+/// Computes Keccak hashes of multiple independent inputs in parallel.
+/// The outputs must have the same size as the inputs.
+void keccak256_many(std::span<const bytes_view> inputs, std::span<hash256> outputs) noexcept;
 }  // namespace zvmone
 
 std::ostream& operator<<(std::ostream& out, const zvmone::address& a);
@@ -5,30 +5,55 @@
 #include "host.hpp"
 #include "precompiles.hpp"
 #include "rlp.hpp"
+#include <zvmone/zvmone.h>
+#include <cstring>
+#include <type_traits>
+#include <utility>
 
 namespace zvmone::state
 {
-bool Host::account_exists(const address& addr) const noexcept
+namespace
 {
-    const auto* const acc = m_state.find(addr);
-    return acc != nullptr && (!acc->is_empty());
+/// The copy of the ZVMC host interface used by the Host.
+/// The zvmone host extension is registered for this copy so other hosts using the common
+/// interface of zvmc::Host are not affected.
+const zvmc_host_interface host_interface = zvmc::Host::get_interface();
+
+zvmc_access_status access_and_get_storage(zvmc_host_context* context, const zvmc_address* addr,
+    const zvmc_bytes32* key, zvmc_bytes32* value) noexcept
+{
+    bytes32 v;
+    const auto access_status =
+        zvmc::Host::from_context<Host>(context)->access_and_get_storage(*addr, *key, v);
+    *value = v;
+    return access_status;
 }
 
-bytes32 Host::get_storage(const address& addr, const bytes32& key) const noexcept
+zvmc_access_status access_and_set_storage(zvmc_host_context* context, const zvmc_address* addr,
+    const zvmc_bytes32* key, const zvmc_bytes32* value, zvmc_storage_status* status) noexcept
 {
-    const auto& acc = m_state.get(addr);
-    if (const auto it = acc.storage.find(key); it != acc.storage.end())
-        return it->second.current;
-    return {};
+    return zvmc::Host::from_context<Host>(context)->access_and_set_storage(
+        *addr, *key, *value, *status);
 }
 
-zvmc_storage_status Host::set_storage(
-    const address& addr, const bytes32& key, const bytes32& value) noexcept
+void call_preflight(zvmc_host_context* context, const zvmc_address* sender,
+    const zvmc_address* destination, const zvmc_uint256be* value,
+    zvmone_call_preflight* result) noexcept
+{
+    const address dst = destination != nullptr ? *destination : address{};
+    zvmc::Host::from_context<Host>(context)->call_preflight(*sender,
+        destination != nullptr ? &dst : nullptr, intx::be::load<intx::uint256>(*value), *result);
+}
+
+constexpr zvmone_host_extension host_extension{
+    sizeof(zvmone_host_extension), access_and_get_storage, access_and_set_storage, call_preflight};
+
+/// Updates the current value of the storage slot and returns the storage status.
+zvmc_storage_status update_storage_slot(StorageValue& storage_slot, const bytes32& value) noexcept
 {
     // Follow ZVMC documentation https://evmc.ethereum.org/storagestatus.html#autotoc_md3
     // and EIP-2200 specification https://eips.ethereum.org/EIPS/eip-2200.
 
-    auto& storage_slot = m_state.get(addr).storage[key];
     const auto& [current, original, _] = storage_slot;
 
     const auto dirty = original != current;
@@ -66,6 +91,38 @@ zvmc_storage_status Host::set_storage(
     storage_slot.current = value;  // Update current value.
     return status;
 }
+}  // namespace
+
+void register_host_extension(zvmc::VM& vm) noexcept
+{
+    if (std::strcmp(vm.name(), "zvmone") == 0)
+        zvmone_set_host_extension(vm.get_raw_pointer(), &host_interface, &host_extension);
+}
+
+Host::Host(zvmc_revision rev, zvmc::VM& vm, State& state, const BlockInfo& block,
+    const Transaction& tx) noexcept
+  : m_rev{rev}, m_vm{vm}, m_state{state}, m_block{block}, m_tx{tx}
+{}
+
+bool Host::account_exists(const address& addr) const noexcept
+{
+    const auto* const acc = m_state.find(addr);
+    return acc != nullptr && (!acc->is_empty());
+}
+
+bytes32 Host::get_storage(const address& addr, const bytes32& key) const noexcept
+{
+    const auto& acc = m_state.get(addr);
+    if (const auto it = acc.storage.find(key); it != acc.storage.end())
+        return it->second.current;
+    return {};
+}
+
+zvmc_storage_status Host::set_storage(
+    const address& addr, const bytes32& key, const bytes32& value) noexcept
+{
+    return update_storage_slot(get_storage_slot(addr, key), value);
+}
 
 uint256be Host::get_balance(const address& addr) const noexcept
 {
@@ -81,9 +138,8 @@ size_t Host::get_code_size(const address& addr) const noexcept
 
 bytes32 Host::get_code_hash(const address& addr) const noexcept
 {
-    // TODO: Cache code hash. It will be needed also to compute the MPT hash.
     const auto* const acc = m_state.find(addr);
-    return (acc != nullptr && !acc->is_empty()) ? keccak256(acc->code) : bytes32{};
+    return (acc != nullptr && !acc->is_empty()) ? acc->code_hash() : bytes32{};
 }
 
 size_t Host::copy_code(const address& addr, size_t code_offset, uint8_t* buffer_data,
@@ -134,6 +190,7 @@ std::optional<zvmc_message> Host::prepare_message(zvmc_message msg)
     {
         if (sender_nonce == Account::NonceMax)
             return {};  // Light early exception, cannot happen for depth == 0.
+        m_journal.emplace_back(JournalNonceChange{msg.sender, sender_nonce});
         ++sender_acc.nonce;
     }
 
@@ -164,19 +221,27 @@ zvmc::Result Host::create(const zvmc_message& msg) noexcept
         collision_acc != nullptr && (collision_acc->nonce != 0 || !collision_acc->code.empty()))
         return zvmc::Result{ZVMC_FAILURE};
 
-    auto& new_acc = m_state.get_or_insert(msg.recipient);
+    // The account is not erased by the reverts of the nested messages so the reference is valid
+    // for the whole creation.
+    auto& new_acc = get_or_insert(msg.recipient);
     assert(new_acc.nonce == 0);
+    m_journal.emplace_back(JournalNonceChange{msg.recipient, new_acc.nonce});
     new_acc.nonce = 1;
 
     // Clear the new account storage, but keep the access status (from tx access list).
     // This is only needed for tests and cannot happen in real networks.
-    for (auto& [_, v] : new_acc.storage) [[unlikely]]
+    for (auto& [k, v] : new_acc.storage) [[unlikely]]
+    {
+        m_journal.emplace_back(JournalStorageChange{msg.recipient, k, v});
         v = StorageValue{.access_status = v.access_status};
+    }
 
     auto& sender_acc = m_state.get(msg.sender);  // TODO: Duplicated account lookup.
     const auto value = intx::be::load<intx::uint256>(msg.value);
     assert(sender_acc.balance >= value && "ZVM must guarantee balance");
+    m_journal.emplace_back(JournalBalanceChange{msg.sender, sender_acc.balance});
     sender_acc.balance -= value;
+    m_journal.emplace_back(JournalBalanceChange{msg.recipient, new_acc.balance});
     new_acc.balance += value;  // The new account may be prefunded.
 
     auto create_msg = msg;
@@ -184,7 +249,8 @@ zvmc::Result Host::create(const zvmc_message& msg) noexcept
     create_msg.input_data = nullptr;
     create_msg.input_size = 0;
 
-    auto result = m_vm.execute(*this, m_rev, create_msg, msg.input_data, msg.input_size);
+    auto result = m_vm.execute(
+        host_interface, to_context(), m_rev, create_msg, msg.input_data, msg.input_size);
     if (result.status_code != ZVMC_SUCCESS)
     {
         result.create_address = msg.recipient;
@@ -207,9 +273,9 @@ zvmc::Result Host::create(const zvmc_message& msg) noexcept
     if (!code.empty() && code[0] == 0xEF)  // Reject EF code.
         return zvmc::Result{ZVMC_CONTRACT_VALIDATION_FAILURE};
 
-    // TODO: The new_acc pointer is invalid because of the state revert implementation,
-    //       but this should change if state journal is implemented.
-    m_state.get(msg.recipient).code = code;
+    assert(new_acc.code.empty());
+    m_journal.emplace_back(JournalCodeDeployed{msg.recipient});
+    new_acc.code = m_state.share_code(code, keccak256(code));
 
     return zvmc::Result{result.status_code, gas_left, result.gas_refund, msg.recipient};
 }
@@ -221,23 +287,27 @@ zvmc::Result Host::execute_message(const zvmc_message& msg) noexcept
 
     assert(msg.kind != ZVMC_CALL || zvmc::address{msg.recipient} == msg.code_address);
     auto* const dst_acc =
-        (msg.kind == ZVMC_CALL) ? &m_state.touch(msg.recipient) : m_state.find(msg.code_address);
+        (msg.kind == ZVMC_CALL) ? &touch(msg.recipient) : m_state.find(msg.code_address);
 
     if (msg.kind == ZVMC_CALL)
     {
         // Transfer value.
         const auto value = intx::be::load<intx::uint256>(msg.value);
-        assert(m_state.get(msg.sender).balance >= value);
-        m_state.get(msg.sender).balance -= value;
+        auto& sender_acc = m_state.get(msg.sender);
+        assert(sender_acc.balance >= value);
+        m_journal.emplace_back(JournalBalanceChange{msg.sender, sender_acc.balance});
+        sender_acc.balance -= value;
+        m_journal.emplace_back(JournalBalanceChange{msg.recipient, dst_acc->balance});
         dst_acc->balance += value;
     }
 
     if (auto precompiled_result = call_precompile(m_rev, msg); precompiled_result.has_value())
         return std::move(*precompiled_result);
 
-    // Copy of the code. Revert will invalidate the account.
-    const auto code = dst_acc != nullptr ? dst_acc->code : bytes{};
-    return m_vm.execute(*this, m_rev, msg, code.data(), code.size());
+    // The account existed before the execution, so it is not erased by the reverts
+    // and the code is not modified (the code is only deployed to the accounts without code).
+    const auto code = dst_acc != nullptr ? bytes_view{dst_acc->code} : bytes_view{};
+    return m_vm.execute(host_interface, to_context(), m_rev, msg, code.data(), code.size());
 }
 
 zvmc::Result Host::call(const zvmc_message& orig_msg) noexcept
@@ -246,8 +316,8 @@ zvmc::Result Host::call(const zvmc_message& orig_msg) noexcept
     if (!msg.has_value())
         return zvmc::Result{ZVMC_FAILURE, orig_msg.gas};  // Light exception.
 
-    auto state_snapshot = m_state;
-    auto logs_snapshot = m_logs.size();
+    const auto journal_checkpoint = m_journal.size();
+    const auto logs_checkpoint = m_logs.size();
 
     auto result = execute_message(*msg);
 
@@ -258,12 +328,12 @@ zvmc::Result Host::call(const zvmc_message& orig_msg) noexcept
         const auto is_03_touched = acc_03 != nullptr && acc_03->erasable;
 
         // Revert.
-        m_state = std::move(state_snapshot);
-        m_logs.resize(logs_snapshot);
+        rollback(journal_checkpoint);
+        m_logs.resize(logs_checkpoint);
 
         // The 0x03 quirk: the touch on this address is never reverted.
         if (is_03_touched)
-            m_state.touch(addr_03);
+            touch(addr_03);
     }
     return result;
 }
@@ -305,18 +375,131 @@ void Host::emit_log(const address& addr, const uint8_t* data, size_t data_size,
 
 zvmc_access_status Host::access_account(const address& addr) noexcept
 {
-    auto& acc = m_state.get_or_insert(addr, {.erasable = true});
-    const auto status = std::exchange(acc.access_status, ZVMC_ACCESS_WARM);
+    zvmc_access_status status;
+    get_accessed_account(addr, status);
+    return status;
+}
+
+Account& Host::get_accessed_account(const address& addr, zvmc_access_status& status) noexcept
+{
+    auto& acc = get_or_insert(addr, {.erasable = true});
+    status = std::exchange(acc.access_status, ZVMC_ACCESS_WARM);
+    if (status == ZVMC_ACCESS_COLD)
+        m_journal.emplace_back(JournalAccessedAccount{addr});
 
     // Overwrite status for precompiled contracts: they are always warm.
     if (status == ZVMC_ACCESS_COLD && addr >= "Z01"_address && addr <= "Z09"_address)
-        return ZVMC_ACCESS_WARM;
+        status = ZVMC_ACCESS_WARM;
 
-    return status;
+    return acc;
+}
+
+void Host::call_preflight(const address& sender, const address* dst, const intx::uint256& value,
+    zvmone_call_preflight& result) noexcept
+{
+    if (dst != nullptr)
+    {
+        const auto& dst_acc = get_accessed_account(*dst, result.access_status);
+        result.account_exists = !dst_acc.is_empty();
+    }
+    result.balance_sufficient = value == 0 || m_state.get(sender).balance >= value;
 }
 
 zvmc_access_status Host::access_storage(const address& addr, const bytes32& key) noexcept
 {
-    return std::exchange(m_state.get(addr).storage[key].access_status, ZVMC_ACCESS_WARM);
+    bytes32 value;
+    return access_and_get_storage(addr, key, value);
+}
+
+zvmc_access_status Host::access_and_get_storage(
+    const address& addr, const bytes32& key, bytes32& value) noexcept
+{
+    const auto [it, inserted] = m_state.get(addr).storage.try_emplace(key);
+    auto& storage_slot = it->second;
+    value = storage_slot.current;
+    if (storage_slot.access_status == ZVMC_ACCESS_WARM)
+        return ZVMC_ACCESS_WARM;
+
+    if (inserted)
+        m_journal.emplace_back(JournalStorageInserted{addr, key});
+    else
+        m_journal.emplace_back(JournalStorageChange{addr, key, storage_slot});
+    storage_slot.access_status = ZVMC_ACCESS_WARM;
+    return ZVMC_ACCESS_COLD;
+}
+
+zvmc_access_status Host::access_and_set_storage(const address& addr, const bytes32& key,
+    const bytes32& value, zvmc_storage_status& status) noexcept
+{
+    // The single journal entry reverts both the access status and the value.
+    auto& storage_slot = get_storage_slot(addr, key);
+    const auto access_status = std::exchange(storage_slot.access_status, ZVMC_ACCESS_WARM);
+    status = update_storage_slot(storage_slot, value);
+    return access_status;
+}
+
+Account& Host::get_or_insert(const address& addr, Account account)
+{
+    if (auto* const acc = m_state.find(addr); acc != nullptr)
+        return *acc;
+    m_journal.emplace_back(JournalAccountCreated{addr});
+    return m_state.insert(addr, std::move(account));
+}
+
+Account& Host::touch(const address& addr)
+{
+    auto& acc = get_or_insert(addr);
+    if (!acc.erasable)
+    {
+        m_journal.emplace_back(JournalTouched{addr});
+        acc.erasable = true;
+    }
+    return acc;
+}
+
+StorageValue& Host::get_storage_slot(const address& addr, const bytes32& key)
+{
+    const auto [it, inserted] = m_state.get(addr).storage.try_emplace(key);
+    if (inserted)
+        m_journal.emplace_back(JournalStorageInserted{addr, key});
+    else
+        m_journal.emplace_back(JournalStorageChange{addr, key, it->second});
+    return it->second;
+}
+
+void Host::rollback(size_t checkpoint) noexcept
+{
+    // Undo the modifications in the reverse order.
+    while (m_journal.size() > checkpoint)
+    {
+        std::visit(
+            [this](const auto& e) noexcept {
+                using T = std::decay_t<decltype(e)>;
+                if constexpr (std::is_same_v<T, JournalAccountCreated>)
+                    m_state.get_accounts().erase(e.addr);
+                else if constexpr (std::is_same_v<T, JournalTouched>)
+                    m_state.get(e.addr).erasable = false;
+                else if constexpr (std::is_same_v<T, JournalAccessedAccount>)
+                    m_state.get(e.addr).access_status = ZVMC_ACCESS_COLD;
+                else if constexpr (std::is_same_v<T, JournalNonceChange>)
+                    m_state.get(e.addr).nonce = e.prev_nonce;
+                else if constexpr (std::is_same_v<T, JournalBalanceChange>)
+                    m_state.get(e.addr).balance = e.prev_balance;
+                else if constexpr (std::is_same_v<T, JournalStorageInserted>)
+                    m_state.get(e.addr).storage.erase(e.key);
+                else if constexpr (std::is_same_v<T, JournalStorageChange>)
+                    m_state.get(e.addr).storage[e.key] = e.prev;
+                else
+                {
+                    static_assert(std::is_same_v<T, JournalCodeDeployed>);
+                    auto& code = m_state.get(e.addr).code;
+                    const auto code_hash = code.hash();
+                    code = {};
+                    m_state.release_code(code_hash);
+                }
+            },
+            m_journal.back());
+        m_journal.pop_back();
+    }
 }
 }  // namespace zvmone::state
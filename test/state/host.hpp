@@ -7,6 +7,9 @@
 #include "state.hpp"
 #include <optional>
 #include <unordered_set>
+#include <variant>
+
+struct zvmone_call_preflight;
 
 namespace zvmone::state
 {
@@ -28,6 +31,60 @@ inline constexpr size_t max_initcode_size = 2 * max_code_size;
 address compute_new_account_address(const address& sender, uint64_t sender_nonce,
     const std::optional<bytes32>& salt, bytes_view init_code) noexcept;
 
+/// The journal entries of the state modifications.
+/// Each entry records what is needed to revert the modification.
+/// @{
+struct JournalAccountCreated
+{
+    address addr;
+};
+
+struct JournalTouched
+{
+    address addr;
+};
+
+struct JournalAccessedAccount
+{
+    address addr;
+};
+
+struct JournalNonceChange
+{
+    address addr;
+    uint64_t prev_nonce = 0;
+};
+
+struct JournalBalanceChange
+{
+    address addr;
+    intx::uint256 prev_balance;
+};
+
+struct JournalStorageInserted
+{
+    address addr;
+    bytes32 key;
+};
+
+struct JournalStorageChange
+{
+    address addr;
+    bytes32 key;
+    StorageValue prev;
+};
+
+/// The code is only deployed to the accounts without code.
+struct JournalCodeDeployed
+{
+    address addr;
+};
+
+using JournalEntry = std::variant<JournalAccountCreated, JournalTouched, JournalAccessedAccount,
+    JournalNonceChange, JournalBalanceChange, JournalStorageInserted, JournalStorageChange,
+    JournalCodeDeployed>;
+/// @}
+
 class Host : public zvmc::Host
 {
     zvmc_revision m_rev;
@@ -37,16 +94,34 @@ class Host : public zvmc::Host
     const Transaction& m_tx;
     std::vector<Log> m_logs;
 
+    /// The journal of the state modifications made by the messages.
+    /// The failed message reverts the state by undoing the entries added after its checkpoint
+    /// (the journal size at the message start) instead of restoring a copy of the whole state.
+    std::vector<JournalEntry> m_journal;
+
 public:
     Host(zvmc_revision rev, zvmc::VM& vm, State& state, const BlockInfo& block,
-        const Transaction& tx) noexcept
-      : m_rev{rev}, m_vm{vm}, m_state{state}, m_block{block}, m_tx{tx}
-    {}
+        const Transaction& tx) noexcept;
 
     [[nodiscard]] std::vector<Log>&& take_logs() noexcept { return std::move(m_logs); }
 
     zvmc::Result call(const zvmc_message& msg) noexcept override;
 
+    /// Accesses the storage slot and loads its value with a single lookup
+    /// (zvmone host extension).
+    zvmc_access_status access_and_get_storage(
+        const address& addr, const bytes32& key, bytes32& value) noexcept;
+
+    /// Accesses the storage slot and updates its value with a single lookup
+    /// (zvmone host extension).
+    zvmc_access_status access_and_set_storage(const address& addr, const bytes32& key,
+        const bytes32& value, zvmc_storage_status& status) noexcept;
+
+    /// Answers the checks preceding a call or a contract creation (zvmone host extension).
+    /// The destination account is accessed as by access_account().
+    void call_preflight(const address& sender, const address* dst, const intx::uint256& value,
+        zvmone_call_preflight& result) noexcept;
+
 private:
     [[nodiscard]] bool account_exists(const address& addr) const noexcept override;
 
@@ -89,5 +164,21 @@ private:
     std::optional<zvmc_message> prepare_message(zvmc_message msg);
 
     zvmc::Result execute_message(const zvmc_message& msg) noexcept;
+
+    /// Accesses the account as access_account() and returns it.
+    Account& get_accessed_account(const address& addr, zvmc_access_status& status) noexcept;
+
+    /// Gets an existing account or inserts new account recording it in the journal.
+    Account& get_or_insert(const address& addr, Account account = {});
+
+    /// Touches (as in EIP-161) an existing account or inserts new erasable account
+    /// recording it in the journal.
+    Account& touch(const address& addr);
+
+    /// Gets the account's storage slot for the modification recording it in the journal.
+    StorageValue& get_storage_slot(const address& addr, const bytes32& key);
+
+    /// Reverts the state modifications recorded in the journal after the checkpoint.
+    void rollback(size_t checkpoint) noexcept;
 };
 }  // namespace zvmone::state
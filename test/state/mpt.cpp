@@ -6,6 +6,7 @@
 #include "rlp.hpp"
 #include <algorithm>
 #include <cassert>
+#include <vector>
 
 namespace zvmone::state
 {
@@ -151,6 +152,12 @@ public:
 
     void insert(const Path& path, bytes&& value);
 
+    /// Encodes the node with the hashes of its children.
+    /// The children_hashes points to the hashes of the node's children in order
+    /// and is advanced past them.
+    [[nodiscard]] bytes encode(const hash256*& children_hashes) const;
+
+    /// Computes the hash of the trie with this root node.
     [[nodiscard]] hash256 hash() const;
 };
 
@@ -219,22 +226,18 @@ void MPTNode::insert(const Path& path, bytes&& value)  // NOLINT(misc-no-recursi
     }
 }
 
-hash256 MPTNode::hash() const  // NOLINT(misc-no-recursion)
+bytes MPTNode::encode(const hash256*& children_hashes) const
 {
     switch (m_kind)
     {
     case Kind::leaf:
     {
-        return keccak256(rlp::encode_tuple(m_path.encode(false), m_value));
+        return rlp::encode_tuple(m_path.encode(false), m_value);
     }
     case Kind::branch:
     {
         assert(m_path.length == 0);
 
-        // Temporary storage for children hashes.
-        // The `bytes` type could be used instead, but this way dynamic allocation is avoided.
-        hash256 children_hashes[num_children];
-
         // Views of children hash bytes.
         // Additional always empty item is hash list terminator
         // (required by the spec, although not needed for uniqueness).
@@ -243,17 +246,14 @@ hash256 MPTNode::hash() const  // NOLINT(misc-no-recursion)
         for (size_t i = 0; i < num_children; ++i)
         {
             if (m_children[i])
-            {
-                children_hashes[i] = m_children[i]->hash();
-                children_hash_bytes[i] = children_hashes[i];
-            }
+                children_hash_bytes[i] = *children_hashes++;
         }
 
-        return keccak256(rlp::encode(children_hash_bytes));
+        return rlp::encode(children_hash_bytes);
     }
     case Kind::ext:
     {
-        return keccak256(rlp::encode_tuple(m_path.encode(true), m_children[0]->hash()));
+        return rlp::encode_tuple(m_path.encode(true), *children_hashes++);
     }
     }
 
@@ -261,6 +261,43 @@ hash256 MPTNode::hash() const  // NOLINT(misc-no-recursion)
     return {};
 }
 
+hash256 MPTNode::hash() const
+{
+    // The nodes are hashed level by level from the deepest one, all nodes of a level together
+    // with keccak256_many(). The children of the nodes of a level are the next level in order.
+    std::vector<std::vector<const MPTNode*>> levels{{this}};
+    while (true)
+    {
+        std::vector<const MPTNode*> children;
+        for (const auto* node : levels.back())
+        {
+            for (const auto& child : node->m_children)
+            {
+                if (child)
+                    children.emplace_back(child.get());
+            }
+        }
+        if (children.empty())
+            break;
+        levels.emplace_back(std::move(children));
+    }
+
+    std::vector<hash256> hashes;
+    for (auto level = levels.rbegin(); level != levels.rend(); ++level)
+    {
+        const hash256* children_hashes = hashes.data();
+        std::vector<bytes> encoded_nodes;
+        encoded_nodes.reserve(level->size());
+        for (const auto* node : *level)
+            encoded_nodes.emplace_back(node->encode(children_hashes));
+        assert(children_hashes == hashes.data() + hashes.size());
+
+        const std::vector<bytes_view> views{encoded_nodes.begin(), encoded_nodes.end()};
+        hashes.resize(views.size());
+        keccak256_many(views, hashes);
+    }
+    return hashes[0];
+}
 
 MPT::MPT() noexcept = default;
 MPT::~MPT() noexcept = default;
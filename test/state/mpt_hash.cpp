@@ -12,25 +12,58 @@ namespace zvmone::state
 {
 namespace
 {
-hash256 mpt_hash(const std::unordered_map<hash256, StorageValue>& storage)
+hash256 mpt_hash(const StorageMap& storage)
 {
-    MPT trie;
+    std::vector<bytes_view> keys;
+    std::vector<const bytes32*> values;
     for (const auto& [key, value] : storage)
     {
         if (!is_zero(value.current))  // Skip "deleted" values.
-            trie.insert(keccak256(key), rlp::encode(rlp::trim(value.current)));
+        {
+            keys.emplace_back(key);
+            values.emplace_back(&value.current);
+        }
     }
+    std::vector<hash256> key_hashes(keys.size());
+    keccak256_many(keys, key_hashes);
+
+    MPT trie;
+    for (size_t i = 0; i < keys.size(); ++i)
+        trie.insert(key_hashes[i], rlp::encode(rlp::trim(*values[i])));
     return trie.hash();
 }
 }  // namespace
 
-hash256 mpt_hash(const std::unordered_map<address, Account>& accounts)
+hash256 mpt_hash(const AccountMap& accounts)
 {
+    // The hashes of the addresses and of the codes not hashed yet are computed together.
+    std::vector<bytes_view> keys;
+    std::vector<bytes_view> codes;
+    std::vector<const Code*> uncached;
+    keys.reserve(accounts.size());
+    for (const auto& [addr, acc] : accounts)
+    {
+        keys.emplace_back(addr);
+        if (!acc.code.has_hash())
+        {
+            codes.emplace_back(acc.code);
+            uncached.emplace_back(&acc.code);
+        }
+    }
+    std::vector<hash256> key_hashes(keys.size());
+    std::vector<hash256> code_hashes(codes.size());
+    keccak256_many(keys, key_hashes);
+    keccak256_many(codes, code_hashes);
+    for (size_t j = 0; j < uncached.size(); ++j)
+        uncached[j]->set_hash(code_hashes[j]);
+
     MPT trie;
+    size_t i = 0;
     for (const auto& [addr, acc] : accounts)
     {
-        trie.insert(keccak256(addr),
-            rlp::encode_tuple(acc.nonce, acc.balance, mpt_hash(acc.storage), keccak256(acc.code)));
+        trie.insert(key_hashes[i],
+            rlp::encode_tuple(acc.nonce, acc.balance, mpt_hash(acc.storage), acc.code_hash()));
+        ++i;
     }
     return trie.hash();
 }
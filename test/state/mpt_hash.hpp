@@ -3,18 +3,17 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "account.hpp"
 #include "hash_utils.hpp"
 #include <span>
-#include <unordered_map>
 
 namespace zvmone::state
 {
-struct Account;
 struct Transaction;
 struct TransactionReceipt;
 
 /// Computes Merkle Patricia Trie root hash for the given collection of state accounts.
-hash256 mpt_hash(const std::unordered_map<address, Account>& accounts);
+hash256 mpt_hash(const AccountMap& accounts);
 
 /// Computes Merkle Patricia Trie root hash for the given collection of transactions.
 hash256 mpt_hash(std::span<const Transaction> transactions);
@@ -112,10 +112,11 @@ zvmc_message build_message(const Transaction& tx, int64_t execution_gas_limit) n
 
 void finalize(State& state, zvmc_revision /*rev*/, std::span<Withdrawal> withdrawals)
 {
-    std::erase_if(state.get_accounts(), [](const std::pair<const address, Account>& p) noexcept {
+    erase_if(state.get_accounts(), [](const std::pair<const address, Account>& p) noexcept {
         const auto& acc = p.second;
         return acc.erasable && acc.is_empty();
     });
+    state.prune_codes();
 
     for (const auto& withdrawal : withdrawals)
         state.touch(withdrawal.recipient).balance += withdrawal.get_amount();
@@ -175,7 +176,7 @@ std::variant<TransactionReceipt, std::error_code> transition(
     state.touch(block.coinbase).balance += gas_used * priority_gas_price;
 
     // Apply destructs.
-    std::erase_if(state.get_accounts(),
+    erase_if(state.get_accounts(),
         [](const std::pair<const address, Account>& p) noexcept { return p.second.destructed; });
 
     auto receipt = TransactionReceipt{tx.kind, result.status_code, gas_used, host.take_logs(), {}};
@@ -16,7 +16,10 @@ namespace zvmone::state
 {
 class State
 {
-    std::unordered_map<address, Account> m_accounts;
+    AccountMap m_accounts;
+
+    /// The codes of the state indexed by the code hash.
+    FlatHashMap<bytes32, Code> m_codes;
 
 public:
     /// Inserts the new account at the address.
@@ -61,6 +64,32 @@ public:
         return acc;
     }
 
+    /// Returns the code with the given hash. The code buffer of identical code is reused
+    /// so the accounts deployed by factories or proxies share the code.
+    Code share_code(bytes_view code, const bytes32& code_hash)
+    {
+        const auto [it, inserted] = m_codes.try_emplace(code_hash);
+        if (inserted)
+            it->second = Code{code, code_hash};
+        return it->second;
+    }
+
+    /// Drops the shared code with the given hash if no account uses it anymore,
+    /// e.g. after the code deployment has been reverted.
+    void release_code(const bytes32& code_hash) noexcept
+    {
+        if (const auto it = m_codes.find(code_hash); it != m_codes.end() && it->second.is_unique())
+            m_codes.erase(code_hash);
+    }
+
+    /// Drops the shared codes not used by any account anymore.
+    void prune_codes() noexcept
+    {
+        erase_if(m_codes, [](const std::pair<const bytes32, Code>& p) noexcept {
+            return p.second.is_unique();
+        });
+    }
+
     [[nodiscard]] auto& get_accounts() noexcept { return m_accounts; }
 
     [[nodiscard]] const auto& get_accounts() const noexcept { return m_accounts; }
@@ -134,6 +163,10 @@ struct TransactionReceipt
 /// Applies withdrawals and deletes empty touched accounts.
 void finalize(State& state, zvmc_revision rev, std::span<Withdrawal> withdrawals);
 
+/// Registers the zvmone host extension of the transition host in the VM if the VM is zvmone.
+/// This should be done once when the VM is set up. The transitions work without it.
+void register_host_extension(zvmc::VM& vm) noexcept;
+
 [[nodiscard]] std::variant<TransactionReceipt, std::error_code> transition(
     State& state, const BlockInfo& block, const Transaction& tx, zvmc_revision rev, zvmc::VM& vm);
 
@@ -86,6 +86,7 @@ int main(int argc, char* argv[])
         CLI11_PARSE(app, argc, argv);
 
         zvmc::VM vm{zvmc_create_zvmone(), {{"O", "0"}}};
+        zvmone::state::register_host_extension(vm);
 
         if (trace_flag)
             vm.set_option("trace", "1");
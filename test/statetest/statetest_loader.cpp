@@ -185,10 +185,11 @@ state::State from_json<state::State>(const json::json& j)
     state::State o;
     for (const auto& [j_addr, j_acc] : j.items())
     {
+        const auto code = from_json<bytes>(j_acc.at("code"));
         auto& acc = o.insert(from_json<address>(j_addr),
             {.nonce = from_json<uint64_t>(j_acc.at("nonce")),
                 .balance = from_json<intx::uint256>(j_acc.at("balance")),
-                .code = from_json<bytes>(j_acc.at("code"))});
+                .code = o.share_code(code, keccak256(code))});
 
         if (const auto storage_it = j_acc.find("storage"); storage_it != j_acc.end())
         {
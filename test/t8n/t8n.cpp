@@ -89,6 +89,7 @@ int main(int argc, const char* argv[])
             const auto j_txs = json::json::parse(std::ifstream{txs_file});
 
             zvmc::VM vm{zvmc_create_zvmone(), {{"O", "0"}}};
+            state::register_host_extension(vm);
 
             std::vector<state::Log> txs_logs;
 
@@ -0,0 +1,189 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <test/utils/bytecode.hpp>
+#include <zvmone/analysis_cache.hpp>
+#include <algorithm>
+#include <filesystem>
+
+using namespace zvmone;
+
+namespace
+{
+constexpr auto rev = ZVMC_SHANGHAI;
+
+const auto code = push(0x2a) + push(0x1e) + OP_DUP2 + OP_SWAP1 + OP_POP + OP_MSTORE8 +
+                  OP_JUMPDEST +
+                  push("000000000000000000000000000000000000000000000000000000000000fe01") +
+                  push(3) + OP_JUMPI + OP_JUMPDEST + OP_GAS + OP_CALL + push(1) + push(2) + OP_ADD +
+                  OP_ADD + push(0x20) + OP_MUL + push(0x0101) + push(2) + OP_EXP + OP_POP + OP_STOP;
+
+/// Compares the Advanced analyses. The push value pointers must point to own storage.
+void expect_equal(
+    const advanced::AdvancedCodeAnalysis& a, const advanced::AdvancedCodeAnalysis& b)
+{
+    ASSERT_EQ(a.instrs.size(), b.instrs.size());
+    ASSERT_EQ(a.push_values, b.push_values);
+    for (size_t i = 0; i < a.instrs.size(); ++i)
+    {
+        EXPECT_EQ(a.instrs[i].fn, b.instrs[i].fn) << i;
+        if (a.instrs[i].fn == advanced::get_op_table(rev)[OP_PUSH32].fn)
+        {
+            EXPECT_EQ(a.instrs[i].arg.push_value - a.push_values.data(),
+                b.instrs[i].arg.push_value - b.push_values.data())
+                << i;
+            EXPECT_GE(b.instrs[i].arg.push_value, b.push_values.data());
+            EXPECT_LT(b.instrs[i].arg.push_value, b.push_values.data() + b.push_values.size());
+        }
+        else
+            EXPECT_EQ(a.instrs[i].arg.number, b.instrs[i].arg.number) << i;
+    }
+    EXPECT_EQ(a.jumpdest_offsets, b.jumpdest_offsets);
+    EXPECT_EQ(a.jumpdest_targets, b.jumpdest_targets);
+    EXPECT_EQ(a.jump_table, b.jump_table);
+    EXPECT_EQ(a.stack_shuffles, b.stack_shuffles);
+    EXPECT_EQ(a.folded_constants, b.folded_constants);
+}
+
+/// Serializes the analysis modified by the given function and expects it is not loaded.
+template <typename Fn>
+void expect_rejected(Fn modify)
+{
+    auto analysis = advanced::analyze(rev, code);
+    modify(analysis);
+    const auto data = serialize(rev, code, analysis);
+    ASSERT_FALSE(data.empty());
+    EXPECT_FALSE(deserialize_advanced(rev, code, data).has_value());
+}
+
+/// Returns the first instruction with the given function.
+advanced::Instruction& find_instr(
+    advanced::AdvancedCodeAnalysis& analysis, advanced::instruction_exec_fn fn)
+{
+    return *std::find_if(analysis.instrs.begin(), analysis.instrs.end(),
+        [fn](const advanced::Instruction& instr) { return instr.fn == fn; });
+}
+}  // namespace
+
+TEST(analysis_cache, advanced_roundtrip)
+{
+    const auto analysis = advanced::analyze(rev, code);
+    const auto data = serialize(rev, code, analysis);
+
+    const auto loaded = deserialize_advanced(rev, code, data);
+    ASSERT_TRUE(loaded.has_value());
+    expect_equal(analysis, *loaded);
+}
+
+TEST(analysis_cache, invalid_data)
+{
+    const auto data = serialize(rev, code, advanced::analyze(rev, code));
+
+    EXPECT_FALSE(deserialize_advanced(rev, code, {}).has_value());
+    EXPECT_FALSE(deserialize_advanced(rev, code, bytes_view{data}.substr(1)).has_value());
+    EXPECT_FALSE(deserialize_advanced(rev, code, data.substr(0, data.size() - 1)).has_value());
+
+    // Other code.
+    const auto other_code = code + OP_STOP;
+    EXPECT_FALSE(deserialize_advanced(rev, other_code, data).has_value());
+    auto same_size_code = code;
+    same_size_code.back() = OP_INVALID;
+    EXPECT_FALSE(deserialize_advanced(rev, same_size_code, data).has_value());
+
+    // Corrupted payload.
+    auto corrupted = data;
+    corrupted.back() ^= 1;
+    EXPECT_FALSE(deserialize_advanced(rev, code, corrupted).has_value());
+
+    // Other build or op table: the fingerprint follows the fixed size fields of the header.
+    auto other_fingerprint = data;
+    other_fingerprint[32] ^= 1;
+    EXPECT_FALSE(deserialize_advanced(rev, code, other_fingerprint).has_value());
+}
+
+TEST(analysis_cache, unsafe_analysis)
+{
+    using namespace advanced;
+
+    // The stack shuffle positions and height change must match the replaced instructions.
+    expect_rejected([](AdvancedCodeAnalysis& a) { a.stack_shuffles[0].src[0] = 20; });
+    expect_rejected([](AdvancedCodeAnalysis& a) { ++a.stack_shuffles[0].height_change; });
+    expect_rejected([](AdvancedCodeAnalysis& a) { ++a.stack_shuffles[0].num_instrs; });
+
+    // The folded range must only push a single value and must not run past the code end.
+    expect_rejected([](AdvancedCodeAnalysis& a) { ++a.folded_constants[0].num_instrs; });
+    expect_rejected([](AdvancedCodeAnalysis& a) { a.folded_constants[0].num_instrs = 1000; });
+
+    // The position of the MUL factor must be one of the two MUL inputs.
+    expect_rejected(
+        [](AdvancedCodeAnalysis& a) { find_instr(a, opx_mul_pow2).arg.number += 2 << 8; });
+
+    // The intrinsic instructions must replace the matching instructions.
+    expect_rejected([](AdvancedCodeAnalysis& a) { a.instrs[0].fn = opx_div_pow2; });
+
+    // The block stack requirements must be the re-derived ones.
+    expect_rejected([](AdvancedCodeAnalysis& a) {
+        a.instrs[static_cast<size_t>(a.jumpdest_targets.back())].arg.block.stack_req = 0;
+    });
+
+    // The gas costs may only be increased by the cost of the folded EXP.
+    expect_rejected([](AdvancedCodeAnalysis& a) { --a.instrs[0].arg.block.gas_cost; });
+    expect_rejected([](AdvancedCodeAnalysis& a) { ++a.instrs[0].arg.block.gas_cost; });
+    expect_rejected([](AdvancedCodeAnalysis& a) {
+        ++find_instr(a, get_op_table(rev)[OP_GAS].fn).arg.number;
+    });
+}
+
+TEST(analysis_cache, directory)
+{
+    const auto dir = std::filesystem::temp_directory_path() / "zvmone-analysis-cache-test";
+    std::filesystem::remove_all(dir);
+
+    {
+        AnalysisCache cache{dir.string()};
+        const auto a1 = cache.get_advanced(rev, code);
+        const auto a2 = cache.get_advanced(rev, code);
+        EXPECT_EQ(a1, a2);
+    }  // Pending writes are flushed.
+
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator{dir},
+                  std::filesystem::directory_iterator{}),
+        1);
+
+    {
+        AnalysisCache cache{dir.string()};
+        expect_equal(advanced::analyze(rev, code), *cache.get_advanced(rev, code));
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST(analysis_cache, eviction)
+{
+    const auto dir = std::filesystem::temp_directory_path() / "zvmone-analysis-cache-eviction";
+    std::filesystem::remove_all(dir);
+
+    {
+        // The limit fits a single analysis only.
+        AnalysisCache cache{dir.string(), 1};
+        const auto a1 = cache.get_advanced(rev, code);
+        const auto size = cache.memory_size();
+        EXPECT_GT(size, code.size());
+
+        const auto other_code = code + OP_STOP;
+        const auto a2 = cache.get_advanced(rev, other_code);
+        EXPECT_NE(a1, a2);
+        EXPECT_LT(cache.memory_size(), 2 * size);  // Only the latest analysis is kept.
+
+        // The evicted analysis is still valid and gets recreated on next use.
+        expect_equal(advanced::analyze(rev, code), *a1);
+        const auto a3 = cache.get_advanced(rev, code);
+        EXPECT_NE(a1, a3);
+        expect_equal(*a1, *a3);
+        EXPECT_EQ(cache.memory_size(), size);
+    }
+
+    std::filesystem::remove_all(dir);
+}
@@ -41,17 +41,131 @@ TEST(analysis, stack_up_and_down)
 
     ASSERT_EQ(analysis.instrs.size(), 20);
     EXPECT_EQ(analysis.instrs[0].fn, op_tbl[OPX_BEGINBLOCK].fn);
-    EXPECT_EQ(analysis.instrs[1].fn, op_tbl[OP_DUP2].fn);
+    EXPECT_EQ(analysis.instrs[1].fn, opx_shuffle);
     EXPECT_EQ(analysis.instrs[2].fn, op_tbl[OP_DUP1].fn);
     EXPECT_EQ(analysis.instrs[8].fn, op_tbl[OP_POP].fn);
     EXPECT_EQ(analysis.instrs[18].fn, op_tbl[OP_PUSH1].fn);
 
+    ASSERT_EQ(analysis.stack_shuffles.size(), 1);
+    EXPECT_EQ(analysis.stack_shuffles[0].num_instrs, 17);
+    EXPECT_EQ(analysis.stack_shuffles[0].height_change, -1);
+    EXPECT_EQ(analysis.stack_shuffles[0].size, 0);
+
     const auto& block = analysis.instrs[0].arg.block;
     EXPECT_EQ(block.gas_cost, uint32_t{7 * 3 + 10 * 2 + 3});
     EXPECT_EQ(block.stack_req, 3);
     EXPECT_EQ(block.stack_max_growth, 7);
 }
 
+TEST(analysis, stack_shuffle)
+{
+    const auto code =
+        push(1) + push(2) + OP_SWAP1 + OP_DUP2 + OP_POP + OP_ADD + OP_DUP1 + OP_ADD + OP_SWAP1;
+    const auto analysis = analyze(rev, code);
+
+    ASSERT_EQ(analysis.instrs.size(), 11);
+    EXPECT_EQ(analysis.instrs[3].fn, opx_shuffle);
+    EXPECT_EQ(analysis.instrs[3].arg.number, 0);
+    EXPECT_EQ(analysis.instrs[4].fn, op_tbl[OP_DUP2].fn);
+    EXPECT_EQ(analysis.instrs[5].fn, op_tbl[OP_POP].fn);
+    EXPECT_EQ(analysis.instrs[6].fn, op_tbl[OP_ADD].fn);
+    EXPECT_EQ(analysis.instrs[7].fn, op_tbl[OP_DUP1].fn);  // Single instruction is not merged.
+    EXPECT_EQ(analysis.instrs[9].fn, op_tbl[OP_SWAP1].fn);
+
+    ASSERT_EQ(analysis.stack_shuffles.size(), 1);
+    const auto& shuffle = analysis.stack_shuffles[0];
+    EXPECT_EQ(shuffle.num_instrs, 3);
+    EXPECT_EQ(shuffle.height_change, 0);
+    ASSERT_EQ(shuffle.size, 2);
+    EXPECT_EQ(shuffle.src[0], 1);
+    EXPECT_EQ(shuffle.src[1], 0);
+
+    // The block requirements are computed for the original instructions.
+    const auto& block = analysis.instrs[0].arg.block;
+    EXPECT_EQ(block.stack_req, 1);
+    EXPECT_EQ(block.stack_max_growth, 3);
+
+    // The tracing requires the original instructions.
+    EXPECT_TRUE(analyze(rev, code, true).stack_shuffles.empty());
+}
+
+TEST(analysis, stack_shuffle_size_limit)
+{
+    const auto code = push(1) + 30 * OP_DUP1 + OP_JUMPDEST + 2 * OP_SWAP1 + 2 * OP_POP;
+    const auto analysis = analyze(rev, code);
+
+    ASSERT_EQ(analysis.stack_shuffles.size(), 3);
+    EXPECT_EQ(analysis.stack_shuffles[0].num_instrs, 23);
+    EXPECT_EQ(analysis.stack_shuffles[0].size, 23);  // The bottom item is not moved.
+    EXPECT_EQ(analysis.stack_shuffles[0].height_change, 23);
+    EXPECT_EQ(analysis.instrs[2].fn, opx_shuffle);
+    EXPECT_EQ(analysis.stack_shuffles[1].num_instrs, 7);
+    EXPECT_EQ(analysis.instrs[25].fn, opx_shuffle);
+
+    // The shuffle does not cross the block boundary.
+    // The SWAP1 pair is no-op so only the POPs remain.
+    EXPECT_EQ(analysis.stack_shuffles[2].num_instrs, 4);
+    EXPECT_EQ(analysis.stack_shuffles[2].height_change, -2);
+    EXPECT_EQ(analysis.stack_shuffles[2].size, 0);
+    EXPECT_EQ(analysis.instrs[33].fn, opx_shuffle);
+}
+
+TEST(analysis, constant_folding)
+{
+    const auto code = push(3) + push(4) + OP_ADD + push(5) + OP_MUL + push(0xe0) + push(2) +
+                      OP_EXP + OP_ADD + OP_CALLVALUE + OP_ADD;
+    const auto analysis = analyze(rev, code);
+
+    ASSERT_EQ(analysis.instrs.size(), 13);
+    EXPECT_EQ(analysis.instrs[1].fn, opx_push_constant);
+    EXPECT_EQ(analysis.instrs[2].fn, op_tbl[OP_PUSH1].fn);
+    EXPECT_EQ(analysis.instrs[6].fn, opx_push_constant);
+    EXPECT_EQ(analysis.instrs[11].fn, op_tbl[OP_ADD].fn);
+
+    // The folded ranges are merged into the first one. The EXP one is not reachable anymore.
+    ASSERT_EQ(analysis.folded_constants.size(), 2);
+    EXPECT_EQ(analysis.instrs[1].arg.number, 0);
+    EXPECT_EQ(analysis.folded_constants[0].value, 35 + (intx::uint256{1} << 224));
+    EXPECT_EQ(analysis.folded_constants[0].num_instrs, 9);
+
+    // The base gas costs of the replaced instructions and the EXP dynamic cost are charged.
+    EXPECT_EQ(analysis.instrs[0].arg.block.gas_cost, 5 * 3 + 3 * 3 + 5 + 10 + 50 + 2);
+
+    // The tracing requires the original instructions.
+    EXPECT_TRUE(analyze(rev, code, true).folded_constants.empty());
+}
+
+TEST(analysis, constant_folding_non_contiguous)
+{
+    // The constant inputs are not pushed directly before the ADDs so nothing is folded.
+    const auto code = push(1) + push(2) + OP_CALLVALUE + OP_POP + OP_ADD + push(3) + OP_ADD;
+    const auto analysis = analyze(rev, code);
+
+    EXPECT_TRUE(analysis.folded_constants.empty());
+    EXPECT_EQ(analysis.instrs[5].fn, op_tbl[OP_ADD].fn);
+    EXPECT_EQ(analysis.instrs[7].fn, op_tbl[OP_ADD].fn);
+}
+
+TEST(analysis, strength_reduction)
+{
+    // The method selector extraction: calldataload(0) / 2**224.
+    const auto code = push(0xe0) + push(2) + OP_EXP + push(0) + OP_CALLDATALOAD + OP_DIV +
+                      OP_CALLVALUE + push(8) + OP_SWAP1 + OP_MOD + push(0x20) + OP_MUL +
+                      OP_CALLVALUE + OP_MUL + push(3) + OP_CALLVALUE + OP_DIV;
+    const auto analysis = analyze(rev, code);
+
+    ASSERT_EQ(analysis.instrs.size(), 19);
+    EXPECT_EQ(analysis.instrs[1].fn, opx_push_constant);
+    EXPECT_EQ(analysis.instrs[6].fn, opx_div_pow2);
+    EXPECT_EQ(analysis.instrs[6].arg.number, 224);
+    EXPECT_EQ(analysis.instrs[10].fn, opx_mod_pow2);
+    EXPECT_EQ(analysis.instrs[10].arg.number, 3);
+    EXPECT_EQ(analysis.instrs[12].fn, opx_mul_pow2);
+    EXPECT_EQ(analysis.instrs[12].arg.number, 5 | (1 << 8));
+    EXPECT_EQ(analysis.instrs[14].fn, op_tbl[OP_MUL].fn);  // Both factors unknown.
+    EXPECT_EQ(analysis.instrs[17].fn, op_tbl[OP_DIV].fn);  // Not a power of two.
+}
+
 TEST(analysis, push)
 {
     constexpr auto push_value = 0x8807060504030201;
@@ -66,6 +180,19 @@ TEST(analysis, push)
     EXPECT_EQ(analysis.push_values[0], intx::uint256{0xee} << 240);
 }
 
+TEST(analysis, storage_right_sized)
+{
+    // The PUSH data must not be counted as instructions.
+    const auto code = push("ee00000000000000000000000000000000000000000000000000000000000000") +
+                      push(0xff) + OP_POP + OP_POP;
+    const auto analysis = analyze(rev, code);
+
+    ASSERT_EQ(analysis.instrs.size(), 6);
+    EXPECT_LE(analysis.instrs.capacity(), 6);
+    ASSERT_EQ(analysis.push_values.size(), 1);
+    EXPECT_LE(analysis.push_values.capacity(), 1);
+}
+
 TEST(analysis, jumpdest_skip)
 {
     // If the JUMPDEST is the first instruction in a basic block it should be just omitted
@@ -93,6 +220,50 @@ TEST(analysis, jump1)
     EXPECT_EQ(find_jumpdest(analysis, 6), 5);
     EXPECT_EQ(find_jumpdest(analysis, 0), -1);
     EXPECT_EQ(find_jumpdest(analysis, 7), -1);
+
+    ASSERT_EQ(analysis.jump_table.size(), 7);
+    for (int i = 0; i < 6; ++i)
+        EXPECT_EQ(analysis.jump_table[static_cast<size_t>(i)], 0);
+    EXPECT_EQ(analysis.jump_table[6], 5 + 1);
+}
+
+TEST(analysis, jump_table_sparse_jumpdests)
+{
+    // A single JUMPDEST covers max_jump_table_sparsity table entries.
+    auto code = bytes(max_jump_table_sparsity - 1, uint8_t{OP_STOP}) + uint8_t{OP_JUMPDEST};
+    auto analysis = analyze(rev, code);
+    EXPECT_EQ(analysis.jump_table.size(), max_jump_table_sparsity);
+    EXPECT_EQ(find_jumpdest(analysis, static_cast<int>(max_jump_table_sparsity - 1)),
+        analysis.jumpdest_targets[0]);
+
+    // Sparser JUMPDESTs use the binary search.
+    code.insert(code.begin(), OP_STOP);
+    analysis = analyze(rev, code);
+    EXPECT_TRUE(analysis.jump_table.empty());
+    EXPECT_EQ(find_jumpdest(analysis, static_cast<int>(max_jump_table_sparsity)),
+        analysis.jumpdest_targets[0]);
+    EXPECT_EQ(find_jumpdest(analysis, 0), -1);
+}
+
+TEST(analysis, jump_table_size_limit)
+{
+    constexpr auto n = static_cast<int>(max_jump_table_size);
+
+    // The last JUMPDEST is at the offset n - 1: the jump table is used.
+    auto code = bytes(max_jump_table_size, uint8_t{OP_JUMPDEST});
+    auto analysis = analyze(rev, code);
+    EXPECT_EQ(analysis.jump_table.size(), max_jump_table_size);
+    EXPECT_EQ(find_jumpdest(analysis, 0), 1);
+    EXPECT_EQ(find_jumpdest(analysis, n - 1), n);
+    EXPECT_EQ(find_jumpdest(analysis, n), -1);
+
+    // One more JUMPDEST: fall back to the binary search.
+    code.push_back(OP_JUMPDEST);
+    analysis = analyze(rev, code);
+    EXPECT_TRUE(analysis.jump_table.empty());
+    EXPECT_EQ(find_jumpdest(analysis, 0), 1);
+    EXPECT_EQ(find_jumpdest(analysis, n), n + 1);
+    EXPECT_EQ(find_jumpdest(analysis, n + 1), -1);
 }
 
 TEST(analysis, empty)
@@ -0,0 +1,167 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <zvmone/arithmetic_kernels.hpp>
+#include <string_view>
+#include <vector>
+
+using namespace zvmone;
+using intx::uint256;
+
+namespace
+{
+/// Returns the test values: the edge cases, the values with single words set
+/// and the pseudo-random values.
+std::vector<uint256> generate_values()
+{
+    std::vector<uint256> values{0, 1, 0x7f, 0x80, 0xff, ~uint256{0}, uint256{1} << 255};
+    for (size_t i = 0; i < uint256::num_words; ++i)
+    {
+        for (const auto w : {uint64_t{1}, uint64_t{0x80}, uint64_t{1} << 63, ~uint64_t{0}})
+        {
+            uint256 x;
+            x[i] = w;
+            values.emplace_back(x);
+            values.emplace_back(~x);
+        }
+    }
+
+    uint64_t seed = 1;
+    for (size_t n = 0; n < 16; ++n)
+    {
+        uint256 x;
+        for (size_t i = 0; i < uint256::num_words; ++i)
+        {
+            seed = seed * 6364136223846793005 + 1442695040888963407;
+            x[i] = seed;
+        }
+        values.emplace_back(x);
+    }
+    return values;
+}
+
+/// Returns the pairs of the values differing only in a single word by 1.
+std::vector<std::pair<uint256, uint256>> generate_close_pairs(const std::vector<uint256>& values)
+{
+    std::vector<std::pair<uint256, uint256>> pairs;
+    for (const auto& x : values)
+    {
+        for (size_t i = 0; i < uint256::num_words; ++i)
+        {
+            auto y = x;
+            ++y[i];
+            pairs.emplace_back(x, y);
+            pairs.emplace_back(y, x);
+        }
+    }
+    return pairs;
+}
+
+/// Sign-extends x from the byte of the given index with the intx operations.
+uint256 signextend_reference(const uint256& x, unsigned sign_byte_index)
+{
+    const auto sign_bit = sign_byte_index * 8 + 7;
+    const auto mask = (uint256{2} << sign_bit) - 1;
+    return (x & (uint256{1} << sign_bit)) != 0 ? (x | ~mask) : (x & mask);
+}
+}  // namespace
+
+TEST(arithmetic_kernels, isa_support)
+{
+    // The kernels selected at compile time must be supported (checked in cpu_check.cpp).
+    const std::string_view isa_name{kernels::isa_name};
+    if (isa_name == "avx512")
+    {
+        EXPECT_TRUE(kernels::is_supported(kernels::Isa::avx512));
+    }
+    if (isa_name == "avx512" || isa_name == "avx2")
+    {
+        EXPECT_TRUE(kernels::is_supported(kernels::Isa::avx2));
+    }
+}
+
+TEST(arithmetic_kernels, lt)
+{
+    const auto values = generate_values();
+    auto pairs = generate_close_pairs(values);
+    for (const auto& x : values)
+    {
+        for (const auto& y : values)
+            pairs.emplace_back(x, y);
+    }
+
+    for (const auto& [x, y] : pairs)
+        EXPECT_EQ(kernels::lt(x, y), x < y) << hex(x) << " < " << hex(y);
+
+#if ZVMONE_KERNELS_X86_64
+    if (!kernels::is_supported(kernels::Isa::avx512))
+        GTEST_SKIP() << "AVX-512 not supported";
+    for (const auto& [x, y] : pairs)
+        EXPECT_EQ(kernels::detail::lt_avx512(x, y), x < y) << hex(x) << " < " << hex(y);
+#endif
+}
+
+TEST(arithmetic_kernels, eq)
+{
+    const auto values = generate_values();
+    auto pairs = generate_close_pairs(values);
+    for (const auto& x : values)
+    {
+        for (const auto& y : values)
+            pairs.emplace_back(x, y);
+    }
+
+    for (const auto& [x, y] : pairs)
+        EXPECT_EQ(kernels::eq(x, y), x == y) << hex(x) << " == " << hex(y);
+
+#if ZVMONE_KERNELS_X86_64
+    if (!kernels::is_supported(kernels::Isa::avx2))
+        GTEST_SKIP() << "AVX2 not supported";
+    for (const auto& [x, y] : pairs)
+        EXPECT_EQ(kernels::detail::eq_avx2(x, y), x == y) << hex(x) << " == " << hex(y);
+#endif
+}
+
+TEST(arithmetic_kernels, is_zero)
+{
+    const auto values = generate_values();
+    for (const auto& x : values)
+        EXPECT_EQ(kernels::is_zero(x), x == 0) << hex(x);
+
+#if ZVMONE_KERNELS_X86_64
+    if (!kernels::is_supported(kernels::Isa::avx2))
+        GTEST_SKIP() << "AVX2 not supported";
+    for (const auto& x : values)
+        EXPECT_EQ(kernels::detail::is_zero_avx2(x), x == 0) << hex(x);
+#endif
+}
+
+TEST(arithmetic_kernels, signextend)
+{
+    const auto values = generate_values();
+    for (const auto& x : values)
+    {
+        for (unsigned i = 0; i < 31; ++i)
+        {
+            auto r = x;
+            kernels::signextend(r, i);
+            EXPECT_EQ(r, signextend_reference(x, i)) << hex(x) << " " << i;
+        }
+    }
+
+#if ZVMONE_KERNELS_X86_64
+    if (!kernels::is_supported(kernels::Isa::avx512))
+        GTEST_SKIP() << "AVX-512 not supported";
+    for (const auto& x : values)
+    {
+        for (unsigned i = 0; i < 31; ++i)
+        {
+            auto r = x;
+            kernels::detail::signextend_avx512(r, i);
+            EXPECT_EQ(r, signextend_reference(x, i)) << hex(x) << " " << i;
+        }
+    }
+#endif
+}
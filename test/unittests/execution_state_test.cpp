@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 #include <zvmone/advanced_analysis.hpp>
 #include <zvmone/execution_state.hpp>
+#include <algorithm>
 #include <type_traits>
 
 static_assert(std::is_default_constructible_v<zvmone::ExecutionState>);
@@ -19,6 +20,42 @@ static_assert(!std::is_copy_constructible_v<zvmone::advanced::AdvancedExecutionS
 static_assert(!std::is_move_assignable_v<zvmone::advanced::AdvancedExecutionState>);
 static_assert(!std::is_copy_assignable_v<zvmone::advanced::AdvancedExecutionState>);
 
+namespace
+{
+/// Creates the chain of the nested shared stacks filled with non-zero items
+/// and returns the pointer to the top item of the deepest one.
+intx::uint256* fill_nested_stacks(zvmone::StackSpace& parent, size_t depth)
+{
+    constexpr auto limit = zvmone::StackSpace::limit;
+    const zvmone::StackSpace::NestedScope scope{parent, parent.bottom() + limit};
+    zvmone::StackSpace stack_space{true};
+    std::fill_n(stack_space.bottom() + 1, limit, 1);
+    return depth == 1 ? stack_space.bottom() + limit : fill_nested_stacks(stack_space, depth - 1);
+}
+
+/// Executes the chain of the nested calls, each growing the memory to the given size
+/// and returning the output from the beginning of it. The caller keeps the output as the return
+/// data until it returns. Adds the buffer sizes kept alive by the return data to retained_size.
+zvmc::Result nested_call(zvmone::Memory::Backend backend, size_t memory_size, size_t output_size,
+    int depth, size_t& retained_size)
+{
+    zvmone::Memory memory;
+    memory.set_backend(backend);
+    memory.grow(memory_size);
+    memory[output_size - 1] = static_cast<uint8_t>(depth);
+
+    zvmc::Result return_data;
+    if (depth > 0)
+    {
+        return_data = nested_call(backend, memory_size, output_size, depth - 1, retained_size);
+        EXPECT_EQ(return_data.output_size, output_size);
+        EXPECT_EQ(return_data.output_data[output_size - 1], depth - 1);
+        retained_size += zvmone::Memory::get_result_buffer_size(return_data.output_data);
+    }
+    return zvmc::Result{memory.make_result(ZVMC_SUCCESS, 0, 0, 0, output_size)};
+}
+}  // namespace
+
 TEST(execution_state, construct)
 {
     zvmc_message msg{};
@@ -80,7 +117,8 @@ TEST(execution_state, reset_advanced)
     st.memory.grow(64);
     st.msg = &msg;
     st.rev = ZVMC_SHANGHAI;
-    st.return_data.push_back('0');
+    const uint8_t output[]{'0'};
+    st.return_data = zvmc::Result{ZVMC_SUCCESS, 0, 0, output, std::size(output)};
     st.status = ZVMC_FAILURE;
     st.output_offset = 3;
     st.output_size = 4;
@@ -172,3 +210,203 @@ TEST(execution_state, memory_view)
     EXPECT_EQ(view[1], 0x00);
     EXPECT_EQ(view[2], 0xc2);
 }
+
+TEST(execution_state, memory_grow)
+{
+    using zvmone::Memory;
+    for (const auto backend : {Memory::Backend::heap, Memory::Backend::virtual_memory})
+    {
+        Memory memory;
+        memory.set_backend(backend);
+        EXPECT_EQ(memory.backend(), backend);
+
+        for (int i = 0; i < 2; ++i)
+        {
+            // Grow in steps crossing the heap size limit and fill the memory with non-zero bytes.
+            size_t size = 0;
+            for (const auto new_size : {size_t{32}, size_t{4096 + 32}, Memory::heap_size_limit,
+                     Memory::heap_size_limit + 32, 3 * Memory::heap_size_limit})
+            {
+                memory.grow(new_size);
+                ASSERT_EQ(memory.size(), new_size);
+                for (auto j = size; j < new_size; ++j)
+                {
+                    ASSERT_EQ(memory[j], 0) << j;
+                    memory[j] = static_cast<uint8_t>(j + 1);
+                }
+                for (size_t j = 0; j < new_size; j += 101)
+                    ASSERT_EQ(memory[j], static_cast<uint8_t>(j + 1)) << j;
+                size = new_size;
+            }
+
+            // The memory reused after clear() must be zeroed again.
+            memory.clear();
+            EXPECT_EQ(memory.size(), 0);
+        }
+    }
+}
+
+TEST(execution_state, memory_reservation_reuse)
+{
+    using zvmone::Memory;
+    constexpr auto size = 2 * Memory::retained_dirty_size + 4096;
+    for (const auto backend : {Memory::Backend::virtual_memory, Memory::Backend::arena})
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            // The reserved range released by the previous iteration is reused
+            // and its pages above the retained size are released to the OS.
+            Memory memory;
+            memory.set_backend(backend);
+            memory.grow(size);
+            for (size_t j = 0; j < size; j += 512)
+            {
+                ASSERT_EQ(memory[j], 0) << j;
+                memory[j] = 0xdd;
+            }
+        }
+    }
+}
+
+TEST(execution_state, memory_arena_nested)
+{
+    using zvmone::Memory;
+    Memory outer;
+    outer.set_backend(Memory::Backend::arena);
+    outer.grow(64);
+    outer[63] = 0xff;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        {
+            // The inner memory is placed after the outer one and leaves it intact.
+            Memory inner;
+            inner.set_backend(Memory::Backend::arena);
+            inner.grow(4096);
+            for (size_t j = 0; j < inner.size(); ++j)
+            {
+                ASSERT_EQ(inner[j], 0) << j;
+                inner[j] = 0xee;
+            }
+            EXPECT_EQ(outer[63], 0xff);
+        }
+
+        // The outer memory grows over the released inner one and must still be zeroed.
+        outer.grow(outer.size() + 64);
+        for (auto j = outer.size() - 64; j < outer.size(); ++j)
+            ASSERT_EQ(outer[j], 0) << j;
+        EXPECT_EQ(outer[63], 0xff);
+    }
+}
+
+TEST(execution_state, memory_make_result)
+{
+    using zvmone::Memory;
+    for (const auto backend :
+        {Memory::Backend::heap, Memory::Backend::virtual_memory, Memory::Backend::arena})
+    {
+        for (const auto output_offset : {size_t{0}, size_t{7}, size_t{100}})
+        {
+            Memory memory;
+            memory.set_backend(backend);
+            for (int i = 0; i < 2; ++i)  // The memory must be usable after the result creation.
+            {
+                memory.grow(2 * Memory::heap_size_limit);
+                memory[output_offset] = 0xaa;
+                memory[output_offset + 31] = 0xbb;
+
+                zvmc::Result result{memory.make_result(ZVMC_REVERT, 1, 2, output_offset, 32)};
+                EXPECT_EQ(result.status_code, ZVMC_REVERT);
+                EXPECT_EQ(result.gas_left, 1);
+                EXPECT_EQ(result.gas_refund, 2);
+                ASSERT_EQ(result.output_size, 32);
+                EXPECT_EQ(result.output_data[0], 0xaa);
+                EXPECT_EQ(result.output_data[31], 0xbb);
+                EXPECT_EQ(result.create_address, zvmc::address{});
+
+                // The result's fields can be set by the host, e.g. for contract creation.
+                result.create_address = zvmc::address{0xcc};
+                memory.clear();
+            }
+
+            const zvmc::Result empty_result{memory.make_result(ZVMC_SUCCESS, 0, 0, 0, 0)};
+            EXPECT_EQ(empty_result.output_size, 0);
+        }
+    }
+}
+
+TEST(execution_state, memory_result_retained_size)
+{
+    using zvmone::Memory;
+    constexpr auto memory_size = 4 * Memory::heap_size_limit;
+    constexpr int depth = 8;
+    for (const auto backend :
+        {Memory::Backend::heap, Memory::Backend::virtual_memory, Memory::Backend::arena})
+    {
+        // The small outputs are copied so the return data does not keep the callee memories.
+        size_t retained_size = 0;
+        nested_call(backend, memory_size, 32, depth, retained_size);
+        EXPECT_LE(retained_size, depth * Memory::max_copied_output_size);
+
+        // The big outputs take over the memory buffers trimmed after the output.
+        constexpr auto output_size = 2 * Memory::max_copied_output_size;
+        retained_size = 0;
+        nested_call(backend, memory_size, output_size, depth, retained_size);
+        EXPECT_GE(retained_size, depth * output_size);
+        EXPECT_LE(retained_size, depth * 2 * (Memory::buffer_header_size + output_size));
+    }
+}
+
+TEST(execution_state, stack_space_shared)
+{
+    zvmone::StackSpace outer{true};
+    if (!outer.is_shared())
+        GTEST_SKIP() << "shared stack region not supported";
+
+    zvmone::advanced::Stack stack{outer.bottom()};
+    stack.push(1);
+    stack.push(2);
+
+    {
+        // The nested stack starts right above the top item.
+        const zvmone::StackSpace::NestedScope scope{outer, stack.top_item};
+        zvmone::StackSpace inner{true};
+        EXPECT_TRUE(inner.is_shared());
+        EXPECT_EQ(inner.bottom(), stack.top_item);
+
+        // The whole nested stack is usable.
+        zvmone::advanced::Stack inner_stack{inner.bottom()};
+        for (int i = 0; i < zvmone::StackSpace::limit; ++i)
+            inner_stack.push(i);
+        EXPECT_EQ(inner_stack[0], zvmone::StackSpace::limit - 1);
+        EXPECT_EQ(stack[0], 2);
+        EXPECT_EQ(stack[1], 1);
+    }
+
+    // After the nested execution the stack starts at the same place again.
+    zvmone::StackSpace next{true};
+    EXPECT_EQ(next.bottom(), outer.bottom());
+
+    const zvmone::StackSpace exclusive;
+    EXPECT_FALSE(exclusive.is_shared());
+}
+
+TEST(execution_state, stack_space_shared_release)
+{
+    // The nested stacks exceed the retained size of the region.
+    constexpr auto stack_size = zvmone::StackSpace::limit * sizeof(intx::uint256);
+    constexpr auto depth = zvmone::Memory::retained_dirty_size / stack_size + 2;
+
+    intx::uint256* deepest_item = nullptr;
+    {
+        zvmone::StackSpace outer{true};
+        if (!outer.is_shared())
+            GTEST_SKIP() << "shared stack region not supported";
+        deepest_item = fill_nested_stacks(outer, depth);
+        EXPECT_EQ(*deepest_item, 1);
+    }
+
+    // The region stays reserved by the thread. After the outermost execution ends,
+    // the pages above the retained size are returned to the OS and read as zeros.
+    EXPECT_EQ(*deepest_item, 0);
+}
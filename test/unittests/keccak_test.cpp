@@ -0,0 +1,116 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <zvmone/keccak.hpp>
+#include <vector>
+
+using namespace zvmone;
+using namespace zvmc::literals;
+
+namespace
+{
+constexpr KeccakBackend backends[] = {KeccakBackend::generic, KeccakBackend::bmi};
+
+std::vector<uint8_t> generate_input(size_t size)
+{
+    std::vector<uint8_t> input(size);
+    for (size_t i = 0; i < size; ++i)
+        input[i] = static_cast<uint8_t>(i * 7 + 3);
+    return input;
+}
+}  // namespace
+
+TEST(keccak, empty)
+{
+    EXPECT_EQ(keccak256(nullptr, 0),
+        0xc5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470_bytes32);
+}
+
+TEST(keccak, abc)
+{
+    const uint8_t input[]{'a', 'b', 'c'};
+    EXPECT_EQ(keccak256(input, std::size(input)),
+        0x4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45_bytes32);
+}
+
+TEST(keccak, block_boundaries)
+{
+    // The inputs around the 136-byte rate. The 136-byte input needs the second block
+    // for the padding.
+    const std::pair<size_t, zvmc::bytes32> test_cases[] = {
+        {3, 0x7d228cdb40e661b0731cd20c876de675137701233a19b450a36e53a053407a22_bytes32},
+        {135, 0x00ef96af9cf4b24c7f269d922294444a197d0a33638c2e56634c57e892103a8f_bytes32},
+        {136, 0x742061bcad767ed4c4f5883b1dcb1aad11afdcc140dc469d953759b127b9f9ed_bytes32},
+        {137, 0xe3371f61e770abf254c34239c3b0099ad90594507415bc81dd0a10b9692bbf2a_bytes32},
+        {272, 0xac141fd7b0a0ffcd2e967254d508da3ec616596493c36fa304425647d90e6de5_bytes32},
+        {1000, 0x80cdc8dd52cbb3dbaea8f383209893fa2bb52efbd5aedbb4b26dcfe307fcdc9b_bytes32},
+    };
+
+    for (const auto& [size, expected] : test_cases)
+    {
+        const auto input = generate_input(size);
+        EXPECT_EQ(keccak256(input.data(), input.size()), expected) << size;
+        for (const auto backend : backends)
+        {
+            if (is_supported(backend))
+            {
+                EXPECT_EQ(keccak256(input.data(), input.size(), backend), expected) << size;
+            }
+        }
+    }
+}
+
+TEST(keccak, backends)
+{
+    EXPECT_TRUE(is_supported(KeccakBackend::generic));
+    EXPECT_TRUE(is_supported(get_keccak_backend()));
+
+    for (const auto backend : backends)
+    {
+        if (!is_supported(backend))
+            continue;
+
+        uint64_t state[25]{};
+        uint64_t expected[25]{};
+        for (size_t i = 0; i < 3; ++i)
+        {
+            keccakf1600(state, backend);
+            keccakf1600(expected, KeccakBackend::generic);
+        }
+        EXPECT_EQ(std::vector(std::begin(state), std::end(state)),
+            std::vector(std::begin(expected), std::end(expected)));
+    }
+}
+
+TEST(keccak, many)
+{
+    // The inputs of different numbers of blocks hashed in the same groups.
+    const size_t sizes[] = {0, 1, 32, 135, 136, 20, 300, 64, 0, 1000, 32, 32, 271, 5, 64, 64, 7};
+
+    for (size_t count = 0; count <= std::size(sizes); ++count)
+    {
+        std::vector<std::vector<uint8_t>> data;
+        std::vector<bytes_view> inputs;
+        for (size_t i = 0; i < count; ++i)
+            data.emplace_back(generate_input(sizes[i] + i));
+        for (const auto& d : data)
+            inputs.emplace_back(d.data(), d.size());
+
+        for (const auto backend :
+            {KeccakBatchBackend::sequential, KeccakBatchBackend::avx2, KeccakBatchBackend::avx512})
+        {
+            if (!is_supported(backend))
+                continue;
+
+            std::vector<zvmc::bytes32> outputs(count);
+            keccak256_many(inputs.data(), outputs.data(), count, backend);
+            for (size_t i = 0; i < count; ++i)
+            {
+                EXPECT_EQ(outputs[i], keccak256(inputs[i].data(), inputs[i].size()))
+                    << count << " " << i;
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <test/state/flat_hash_map.hpp>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+using namespace zvmc::literals;
+using namespace zvmone::state;
+
+namespace
+{
+/// Applies the random operations to the FlatHashMap and to the std::unordered_map
+/// and compares the results.
+template <bool StableValues>
+void check_random_operations(uint64_t num_keys)
+{
+    std::mt19937_64 rng{StableValues};
+    FlatHashMap<zvmc::bytes32, std::string, KeyHash, StableValues> map;
+    std::unordered_map<zvmc::bytes32, std::string> expected;
+
+    for (int i = 0; i < 100'000; ++i)
+    {
+        // The keys are the small numbers so the entries are frequently inserted and erased.
+        const auto key = zvmc::bytes32{rng() % num_keys};
+        const auto value = std::to_string(rng());
+        switch (rng() % 4)
+        {
+        case 0:
+        {
+            const auto [it, inserted] = map.try_emplace(key, value);
+            const auto [expected_it, expected_inserted] = expected.try_emplace(key, value);
+            ASSERT_EQ(inserted, expected_inserted);
+            ASSERT_EQ(it->second, expected_it->second);
+            break;
+        }
+        case 1:
+            ASSERT_EQ(map.erase(key), expected.erase(key));
+            break;
+        case 2:
+            map[key] += value;
+            expected[key] += value;
+            break;
+        default:
+        {
+            const auto it = map.find(key);
+            const auto expected_it = expected.find(key);
+            ASSERT_EQ(it == map.end(), expected_it == expected.end());
+            if (it != map.end())
+            {
+                ASSERT_EQ(it->second, expected_it->second);
+            }
+        }
+        }
+        ASSERT_EQ(map.size(), expected.size());
+    }
+
+    size_t count = 0;
+    for (const auto& [key, value] : map)
+    {
+        EXPECT_EQ(value, expected.at(key));
+        ++count;
+    }
+    EXPECT_EQ(count, expected.size());
+}
+}  // namespace
+
+TEST(state_flat_hash_map, random_operations)
+{
+    check_random_operations<false>(2000);
+}
+
+TEST(state_flat_hash_map, random_operations_stable_values)
+{
+    check_random_operations<true>(2000);
+}
+
+TEST(state_flat_hash_map, random_operations_small)
+{
+    // The map stays within the small tables smaller than a group.
+    check_random_operations<false>(6);
+}
+
+TEST(state_flat_hash_map, empty)
+{
+    const FlatHashMap<zvmc::address, int> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.begin(), map.end());
+    EXPECT_EQ(map.find("Z01"_address), map.end());
+    EXPECT_FALSE(map.contains("Z01"_address));
+}
+
+TEST(state_flat_hash_map, copy_and_move)
+{
+    FlatHashMap<zvmc::address, int> map{{"Z01"_address, 1}, {"Z02"_address, 2}};
+    const auto copy = map;
+    map["Z01"_address] = 3;
+    EXPECT_EQ(copy.at("Z01"_address), 1);
+    EXPECT_EQ(copy.at("Z02"_address), 2);
+
+    const auto moved = std::move(map);
+    EXPECT_EQ(moved.size(), 2);
+    EXPECT_EQ(moved.at("Z01"_address), 3);
+}
+
+TEST(state_flat_hash_map, small_table_reuses_deleted_slots)
+{
+    FlatHashMap<zvmc::bytes32, uint64_t> map;
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        map[zvmc::bytes32{i}] = i;
+        map[zvmc::bytes32{i + 1}] = i + 1;
+        EXPECT_EQ(map.erase(zvmc::bytes32{i}), 1);
+        EXPECT_EQ(map.erase(zvmc::bytes32{i + 1}), 1);
+        EXPECT_FALSE(map.contains(zvmc::bytes32{i}));
+    }
+    EXPECT_TRUE(map.empty());
+}
+
+TEST(state_flat_hash_map, erase_if)
+{
+    FlatHashMap<zvmc::bytes32, uint64_t> map;
+    for (uint64_t i = 0; i < 100; ++i)
+        map[zvmc::bytes32{i}] = i;
+
+    EXPECT_EQ(erase_if(map, [](const auto& p) { return p.second % 2 == 0; }), 50);
+    EXPECT_EQ(map.size(), 50);
+    for (const auto& [key, value] : map)
+        EXPECT_EQ(value % 2, 1);
+    EXPECT_FALSE(map.contains(zvmc::bytes32{2}));
+    EXPECT_TRUE(map.contains(zvmc::bytes32{3}));
+}
+
+TEST(state_flat_hash_map, stable_values)
+{
+    FlatHashMap<zvmc::bytes32, uint64_t, KeyHash, true> map;
+    auto& first = map[zvmc::bytes32{}];
+    first = 1;
+    for (uint64_t i = 1; i < 1000; ++i)
+        map[zvmc::bytes32{i}] = i;
+    EXPECT_EQ(&map.at(zvmc::bytes32{}), &first);
+    EXPECT_EQ(first, 1);
+}
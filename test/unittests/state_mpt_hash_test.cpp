@@ -18,7 +18,7 @@ using namespace intx;
 
 TEST(state_mpt_hash, empty)
 {
-    EXPECT_EQ(mpt_hash(std::unordered_map<zvmone::address, Account>()), emptyMPTHash);
+    EXPECT_EQ(mpt_hash(AccountMap()), emptyMPTHash);
 }
 
 TEST(state_mpt_hash, single_account_v1)
@@ -29,13 +29,13 @@ TEST(state_mpt_hash, single_account_v1)
 
     Account acc;
     acc.balance = 1_u256;
-    const std::unordered_map<address, Account> accounts{{"Z02"_address, acc}};
+    const AccountMap accounts{{"Z02"_address, acc}};
     EXPECT_EQ(mpt_hash(accounts), expected);
 }
 
 TEST(state_mpt_hash, two_accounts)
 {
-    std::unordered_map<address, Account> accounts;
+    AccountMap accounts;
     EXPECT_EQ(mpt_hash(accounts), emptyMPTHash);
 
     accounts["Z00"_address] = Account{};
@@ -45,7 +45,7 @@ TEST(state_mpt_hash, two_accounts)
     Account acc2;
     acc2.nonce = 1;
     acc2.balance = -2_u256;
-    acc2.code = {0x00};
+    acc2.code = bytes{0x00};
     acc2.storage[0x01_bytes32] = {0xfe_bytes32};
     acc2.storage[0x02_bytes32] = {0xfd_bytes32};
     accounts["Z01"_address] = acc2;
@@ -53,13 +53,89 @@ TEST(state_mpt_hash, two_accounts)
         0xd3e845156fca75de99712281581304fbde104c0fc5a102b09288c07cdde0b666_bytes32);
 }
 
+TEST(state_mpt_hash, account_code_hash_cache)
+{
+    Account acc;
+    EXPECT_TRUE(acc.code.has_hash());
+    EXPECT_EQ(acc.code_hash(),
+        0xc5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470_bytes32);
+
+    acc.code = bytes{0x00};
+    EXPECT_FALSE(acc.code.has_hash());
+    EXPECT_EQ(acc.code_hash(),
+        0xbc36789e7a1e281436464229828f817d6612f7b477d66591ff96a9e064bcc98a_bytes32);
+    EXPECT_TRUE(acc.code.has_hash());
+
+    acc.code = Code{bytes{0xfe}, 0x01_bytes32};
+    EXPECT_EQ(acc.code_hash(), 0x01_bytes32);
+
+    // The state root uses and caches the code hash.
+    acc.code = bytes{0x00};
+    const AccountMap accounts{{"Z02"_address, acc}};
+    const auto root = mpt_hash(accounts);
+    EXPECT_TRUE(accounts.at("Z02"_address).code.has_hash());
+    EXPECT_EQ(mpt_hash(accounts), root);
+}
+
+TEST(state_mpt_hash, shared_code)
+{
+    const auto code = bytes{0x60, 0x00};
+    const auto code_hash = keccak256(code);
+
+    State state;
+    auto& acc1 = state.insert("Z01"_address, {.code = state.share_code(code, code_hash)});
+    auto& acc2 = state.insert("Z02"_address, {.code = state.share_code(code, code_hash)});
+    EXPECT_TRUE(acc1.code.shares_buffer(acc2.code));
+    EXPECT_EQ(acc1.code, code);
+    EXPECT_EQ(acc1.code_hash(), code_hash);
+
+    // The copies of the state share the code.
+    const auto state_copy = state;
+    EXPECT_TRUE(state_copy.get_accounts().at("Z01"_address).code.shares_buffer(acc1.code));
+}
+
+TEST(state_mpt_hash, shared_code_pruned)
+{
+    const auto code = bytes{0x60, 0x00};
+    const auto code_hash = keccak256(code);
+
+    State state;
+    const auto shared = state.share_code(code, code_hash);
+    state.insert("Z01"_address, {.code = shared});
+    state.insert("Z02"_address, {.code = shared});
+
+    // The code used by an account is kept.
+    state.get_accounts().erase("Z01"_address);
+    state.prune_codes();
+    EXPECT_TRUE(state.share_code(code, code_hash).shares_buffer(shared));
+
+    // The code not used by any account is dropped.
+    state.get_accounts().erase("Z02"_address);
+    EXPECT_FALSE(shared.is_unique());
+    state.prune_codes();
+    EXPECT_TRUE(shared.is_unique());
+}
+
+TEST(state_mpt_hash, code_hash_set_once)
+{
+    const Code code{bytes{0x60, 0x00}};
+    EXPECT_FALSE(code.has_hash());
+    code.set_hash(0x01_bytes32);
+    EXPECT_TRUE(code.has_hash());
+    EXPECT_EQ(code.hash(), 0x01_bytes32);
+
+    // The hash already set is kept.
+    code.set_hash(0x02_bytes32);
+    EXPECT_EQ(code.hash(), 0x01_bytes32);
+}
+
 TEST(state_mpt_hash, deleted_storage)
 {
     Account acc;
     acc.storage[0x01_bytes32] = {};
     acc.storage[0x02_bytes32] = {0xfd_bytes32};
     acc.storage[0x03_bytes32] = {};
-    const std::unordered_map<address, Account> accounts{{"Z07"_address, acc}};
+    const AccountMap accounts{{"Z07"_address, acc}};
     EXPECT_EQ(mpt_hash(accounts),
         0x4e7338c16731491e0fb5d1623f5265c17699c970c816bab71d4d717f6071414d_bytes32);
 }
@@ -52,7 +52,7 @@ void state_transition::TearDown()
             }
             if (expected_acc.code.has_value())
             {
-                EXPECT_EQ(acc->code, *expected_acc.code) << "account " << addr;
+                EXPECT_EQ(bytes_view{acc->code}, *expected_acc.code) << "account " << addr;
             }
             for (const auto& [key, value] : expected_acc.storage)
             {
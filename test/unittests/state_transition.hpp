@@ -30,7 +30,11 @@ protected:
 
     static constexpr auto Coinbase = "Zc014bace"_address;
 
-    static inline zvmc::VM vm{zvmc_create_zvmone()};
+    static inline zvmc::VM vm = [] {
+        zvmc::VM v{zvmc_create_zvmone()};
+        state::register_host_extension(v);
+        return v;
+    }();
 
     struct ExpectedAccount
     {
@@ -0,0 +1,59 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "../utils/bytecode.hpp"
+#include "state_transition.hpp"
+
+using namespace zvmc::literals;
+using namespace zvmone::test;
+
+TEST_F(state_transition, call_revert)
+{
+    // The callee modifies its storage and receives the value, but reverts.
+    static constexpr auto Callee = "Zca11ee"_address;
+
+    tx.to = To;
+    pre.insert(*tx.to, {.balance = 1, .code = sstore(1, call(Callee).gas(0xffff).value(1))});
+    pre.insert(Callee, {.nonce = 1, .code = sstore(1, 2) + sstore(2, 3) + revert(0, 0)});
+    pre.get(Callee).storage[0x01_bytes32] = {.current = 0x01_bytes32, .original = 0x01_bytes32};
+
+    expect.post[*tx.to].balance = 1;
+    expect.post[*tx.to].storage[0x01_bytes32] = 0x00_bytes32;  // The call has failed.
+    expect.post[Callee].balance = 0;
+    expect.post[Callee].storage[0x01_bytes32] = 0x01_bytes32;  // The slot 2 does not exist.
+}
+
+TEST_F(state_transition, call_nested_revert)
+{
+    // The inner call succeeds, but its modifications are reverted with the outer call.
+    static constexpr auto Outer = "Z0a7e2"_address;
+    static constexpr auto Inner = "Z1a7e2"_address;
+
+    tx.to = To;
+    pre.insert(*tx.to, {.code = sstore(1, call(Outer).gas(0xffff)) + sstore(2, 1)});
+    pre.insert(Outer, {.code = sstore(1, call(Inner).gas(0xffff)) + revert(0, 0)});
+    pre.insert(Inner, {.code = sstore(1, 1)});
+
+    expect.post[*tx.to].storage[0x01_bytes32] = 0x00_bytes32;
+    expect.post[*tx.to].storage[0x02_bytes32] = 0x01_bytes32;
+    expect.post[Outer].exists = true;
+    expect.post[Inner].exists = true;
+}
+
+TEST_F(state_transition, call_value_insufficient_balance)
+{
+    // The call transferring more than the balance fails without the execution,
+    // the second call creates the callee account.
+    static constexpr auto Callee = "Zca11ee"_address;
+
+    tx.to = To;
+    pre.insert(*tx.to, {.balance = 1,
+                           .code = sstore(1, call(Callee).gas(0xffff).value(2)) +
+                                   sstore(2, call(Callee).gas(0xffff).value(1))});
+
+    expect.post[*tx.to].balance = 0;
+    expect.post[*tx.to].storage[0x01_bytes32] = 0x00_bytes32;
+    expect.post[*tx.to].storage[0x02_bytes32] = 0x01_bytes32;
+    expect.post[Callee].balance = 1;
+}
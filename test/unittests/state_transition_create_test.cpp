@@ -32,3 +32,18 @@ TEST_F(state_transition, create_tx)
 
     expect.post[create_address].code = bytes{0xFE};
 }
+
+TEST_F(state_transition, create_revert)
+{
+    // The failed creation is reverted: the new account does not exist (checked by the runner).
+    const auto factory_code =
+        calldatacopy(0, 0, calldatasize()) + sstore(1, create().input(0, calldatasize()));
+    const auto initcode = sstore(1, 1) + revert(0, 0);
+
+    tx.to = To;
+    tx.data = initcode;
+    pre.insert(*tx.to, {.nonce = 1, .code = factory_code});
+
+    expect.post[*tx.to].nonce = pre.get(*tx.to).nonce + 1;  // The nonce bump is not reverted.
+    expect.post[*tx.to].storage[0x01_bytes32] = 0x00_bytes32;
+}
@@ -0,0 +1,31 @@
+// zvmone: Fast Zond Virtual Machine implementation
+// Copyright 2024 The zvmone Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "../utils/bytecode.hpp"
+#include "state_transition.hpp"
+
+using namespace zvmc::literals;
+using namespace zvmone::test;
+
+TEST_F(state_transition, sload_cold_sstore_warm)
+{
+    // The SLOAD accesses the slot so the SSTORE of the same slot does not pay the cold cost.
+    tx.to = To;
+    pre.insert(*tx.to, {.code = sstore(1, add(sload(1), 1))});
+    pre.get(*tx.to).storage[0x01_bytes32] = {.current = 0x01_bytes32, .original = 0x01_bytes32};
+
+    expect.gas_used = 21000 + 3 + 2100 + 3 + 3 + 3 + 2900;
+    expect.post[*tx.to].storage[0x01_bytes32] = 0x02_bytes32;
+}
+
+TEST_F(state_transition, sstore_cold_sload_warm)
+{
+    // The SSTORE of a new slot makes it warm and the SLOAD loads the new value.
+    tx.to = To;
+    pre.insert(*tx.to, {.code = sstore(1, 1) + sstore(2, sload(1))});
+
+    expect.gas_used = 21000 + (3 + 3 + 2100 + 20000) + (3 + 100 + 3 + 2100 + 20000);
+    expect.post[*tx.to].storage[0x01_bytes32] = 0x01_bytes32;
+    expect.post[*tx.to].storage[0x02_bytes32] = 0x01_bytes32;
+}
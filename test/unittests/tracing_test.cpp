@@ -281,6 +281,60 @@ TEST_F(tracing, trace_undefined_instruction)
 )");
 }
 
+TEST_F(tracing, advanced_matches_baseline)
+{
+    zvmc::VM advanced_vm{zvmc_create_zvmone(), {{"advanced", ""}}};
+    static_cast<zvmone::VM*>(advanced_vm.get_raw_pointer())
+        ->add_tracer(zvmone::create_instruction_tracer(trace_stream));
+    vm.add_tracer(zvmone::create_instruction_tracer(trace_stream));
+
+    const auto loop = push(3) + OP_JUMPDEST + push(1) + OP_SWAP1 + OP_SUB + OP_DUP1 + push(2) +
+                      OP_JUMPI + OP_GAS + OP_POP;
+    const bytecode codes[] = {
+        add(2, 3),
+        push(0xabcdef) + ret_top(),
+        mstore(0, 0x0e4404) + push(3) + push(29) + OP_REVERT,
+        bytecode{} + OP_JUMPDEST + "EF",
+        loop,
+    };
+
+    for (const auto& code : codes)
+    {
+        const auto baseline_trace = trace(code);
+
+        zvmc::MockedHost host;
+        zvmc_message msg{};
+        msg.gas = 1000000;
+        advanced_vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+        const auto advanced_trace = trace_stream.str();
+        trace_stream.str({});
+
+        EXPECT_EQ(advanced_trace, baseline_trace) << hex(code);
+    }
+}
+
+TEST_F(tracing, advanced_histogram)
+{
+    zvmc::VM advanced_vm{zvmc_create_zvmone(), {{"advanced", ""}}};
+    static_cast<zvmone::VM*>(advanced_vm.get_raw_pointer())
+        ->add_tracer(zvmone::create_histogram_tracer(trace_stream));
+
+    const auto code = push(0) + OP_DUP1 + OP_SWAP1 + OP_POP + OP_POP;
+    zvmc::MockedHost host;
+    zvmc_message msg{};
+    msg.gas = 1000000;
+    trace_stream << '\n';
+    advanced_vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(trace_stream.str(), R"(
+--- # HISTOGRAM depth=0
+opcode,count
+POP,2
+PUSH1,1
+DUP1,1
+SWAP1,1
+)");
+}
+
 TEST_F(tracing, trace_code_containing_zero)
 {
     auto tracer_ptr = std::make_unique<Inspector>();
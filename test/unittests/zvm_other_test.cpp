@@ -152,3 +152,62 @@ TEST_P(zvm, jumpdest_with_high_offset)
         EXPECT_EQ(result.status_code, ZVMC_SUCCESS) << "JUMPDEST at " << offset;
     }
 }
+
+TEST_P(zvm, zvmone_stack_shuffle)
+{
+    // The sequence of DUP/SWAP/POP instructions is merged into a single stack shuffle
+    // by the Advanced analysis. The final stack is [1, 1, 3, 4, 4].
+    const auto code = push(1) + push(2) + push(3) + push(4) + OP_SWAP2 + OP_DUP3 + OP_SWAP1 +
+                      OP_POP + OP_DUP4 + OP_SWAP3 + mstore8(0) + mstore8(1) + mstore8(2) +
+                      mstore8(3) + mstore8(4) + ret(0, 5);
+    execute(code);
+    EXPECT_GAS_USED(ZVMC_SUCCESS, 68);
+    ASSERT_EQ(result.output_size, 5);
+    EXPECT_EQ(bytes(result.output_data, result.output_size), (bytes{4, 4, 3, 1, 1}));
+}
+
+TEST_P(zvm, zvmone_stack_shuffle_long)
+{
+    // The sequence exceeding the stack shuffle size limit is split into multiple shuffles.
+    const auto code = push(7) + 40 * OP_DUP1 + push(1) + 20 * OP_SWAP1 + 40 * OP_POP + ret_top();
+    execute(code);
+    EXPECT_STATUS(ZVMC_SUCCESS);
+    EXPECT_OUTPUT_INT(7);
+
+    execute(push(7) + 2 * OP_DUP1 + 4 * OP_POP);
+    EXPECT_STATUS(ZVMC_STACK_UNDERFLOW);
+}
+
+TEST_P(zvm, zvmone_constant_folding)
+{
+    // The constant expressions are folded by the Advanced analysis.
+    // The dynamic gas cost of EXP must still be charged.
+    const auto code = push(3) + push(4) + OP_ADD + push(5) + OP_MUL + push(0xe0) + push(2) +
+                      OP_EXP + OP_ADD + ret_top();
+    execute(code);
+    EXPECT_GAS_USED(ZVMC_SUCCESS, 5 * 3 + 2 * 3 + 5 + 10 + 50 + 3 + 3 + 3 + 3 + 3);
+    EXPECT_OUTPUT_INT(35 + (intx::uint256{1} << 224));
+}
+
+TEST_P(zvm, zvmone_strength_reduction)
+{
+    // The DIV/MOD/MUL by powers of two are replaced with shifts and masks
+    // by the Advanced analysis.
+    const auto selector = push(0xe0) + push(2) + OP_EXP + push(0) + OP_CALLDATALOAD + OP_DIV;
+    const auto input = "a9059cbb00000000000000000000000000000000000000000000000000000000ff"_hex;
+    execute(selector + ret_top(), input);
+    EXPECT_STATUS(ZVMC_SUCCESS);
+    EXPECT_OUTPUT_INT(0xa9059cbb);
+
+    execute(selector + push(0x100) + OP_SWAP1 + OP_MOD + ret_top(), input);
+    EXPECT_STATUS(ZVMC_SUCCESS);
+    EXPECT_OUTPUT_INT(0xbb);
+
+    execute(selector + push(0x10) + OP_MUL + ret_top(), input);
+    EXPECT_STATUS(ZVMC_SUCCESS);
+    EXPECT_OUTPUT_INT(0xa9059cbb0);
+
+    execute(push(0x10) + selector + OP_MUL + ret_top(), input);
+    EXPECT_STATUS(ZVMC_SUCCESS);
+    EXPECT_OUTPUT_INT(0xa9059cbb0);
+}
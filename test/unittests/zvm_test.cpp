@@ -311,6 +311,78 @@ TEST_P(zvm, addmod_mulmod_by_zero)
     EXPECT_EQ(result.output_data[31], 1);
 }
 
+TEST_P(zvm, divmod_operand_widths)
+{
+    // Checks the instructions selecting the arithmetic by the operand widths
+    // against the generic 256-bit implementation.
+    constexpr auto min64 = 0xffffffffffffffffffffffffffffffffffffffffffffffff8000000000000000_u256;
+    const uint256 values[]{0, 1, 2, 3, 7, 0x7fffffffffffffff, 0x8000000000000000,
+        0xffffffffffffffff, 0x10000000000000000_u256, 0xfedcba9876543210fedcba9876543210_u256,
+        0xffffffffffffffffffffffffffffffff_u256, 0x100000000000000000000000000000000_u256,
+        min64, min64 + 1, -uint256{1}, -uint256{2}, -uint256{7}, -uint256{1} >> 1};
+
+    const auto code = calldataload(64) + calldataload(32) + calldataload(0) +
+                      3 * OP_DUP3 + OP_MULMOD + mstore(0) + 3 * OP_DUP3 + OP_ADDMOD + mstore(32) +
+                      2 * OP_DUP2 + OP_DIV + mstore(64) + 2 * OP_DUP2 + OP_MOD + mstore(96) +
+                      2 * OP_DUP2 + OP_SDIV + mstore(128) + OP_SMOD + mstore(160) + ret(0, 192);
+
+    for (const auto& x : values)
+    {
+        for (const auto& y : values)
+        {
+            const auto m = y + 1;
+            uint8_t input[96];
+            intx::be::unsafe::store(&input[0], x);
+            intx::be::unsafe::store(&input[32], y);
+            intx::be::unsafe::store(&input[64], m);
+            SCOPED_TRACE(to_string(x, 16) + " " + to_string(y, 16));
+            execute(code, {input, std::size(input)});
+            ASSERT_EQ(result.status_code, ZVMC_SUCCESS);
+            ASSERT_EQ(output.size(), 192);
+
+            const auto out = [this](size_t i) {
+                return intx::be::unsafe::load<uint256>(&output[i * 32]);
+            };
+            EXPECT_EQ(out(0), m != 0 ? intx::mulmod(x, y, m) : 0);
+            EXPECT_EQ(out(1), m != 0 ? intx::addmod(x, y, m) : 0);
+            EXPECT_EQ(out(2), y != 0 ? x / y : 0);
+            EXPECT_EQ(out(3), y != 0 ? x % y : 0);
+            EXPECT_EQ(out(4), y != 0 ? intx::sdivrem(x, y).quot : 0);
+            EXPECT_EQ(out(5), y != 0 ? intx::sdivrem(x, y).rem : 0);
+        }
+    }
+}
+
+TEST_P(zvm, mulmod_repeated_modulus)
+{
+    // Repeated wide moduli are reduced with the cached Barrett constants.
+    const uint256 moduli[]{
+        0x30644e72e131a029b85045b68181585d97816a916871ca8d3c208c16d87cfd47_u256,
+        0x1000000000000000000000000000000000000000000000000_u256, -uint256{1}, -uint256{2}};
+    const auto x = 0x2b3c4d5e6f708192a3b4c5d6e7f8091a2b3c4d5e6f708192a3b4c5d6e7f80912_u256;
+    const auto y = 0xfedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210_u256;
+
+    // x = MULMOD(x, y, m) repeated 10 times.
+    const auto code = calldataload(64) + calldataload(32) + calldataload(0) +
+                      10 * (3 * OP_DUP3 + OP_MULMOD + OP_SWAP1 + OP_POP) + ret_top();
+
+    for (const auto& m : moduli)
+    {
+        uint8_t input[96];
+        intx::be::unsafe::store(&input[0], x);
+        intx::be::unsafe::store(&input[32], y);
+        intx::be::unsafe::store(&input[64], m);
+        execute(code, {input, std::size(input)});
+        ASSERT_EQ(result.status_code, ZVMC_SUCCESS);
+        ASSERT_EQ(output.size(), sizeof(uint256));
+
+        auto expected = x;
+        for (int i = 0; i < 10; ++i)
+            expected = intx::mulmod(expected, y, m);
+        EXPECT_EQ(intx::be::unsafe::load<uint256>(output.data()), expected) << to_string(m, 16);
+    }
+}
+
 TEST_P(zvm, signextend)
 {
     std::string s;
@@ -403,6 +475,33 @@ TEST_P(zvm, exp_0_0)
     EXPECT_OUTPUT_INT(1);
 }
 
+TEST_P(zvm, exp_bases)
+{
+    // Checks the specialized EXP implementations against the generic one.
+    const uint256 bases[]{0, 1, 2, 3, 7, 10, 16, 256, uint256{1} << 64, uint256{1} << 255, 0x2019,
+        0xfedcba9876543210fedcba9876543210_u256, -uint256{1}, -uint256{10}};
+    const uint256 exponents[]{0, 1, 2, 3, 31, 32, 63, 64, 77, 78, 127, 128, 255, 256, 257,
+        0xffffffff, 0x100000000, 0xfedcba9876543210, 0x10000000000000000_u256,
+        0x8000000000000000000000000000000000000000000000000000000000000001_u256, -uint256{1}};
+
+    const auto code = calldataload(32) + calldataload(0) + OP_EXP + ret_top();
+
+    for (const auto& base : bases)
+    {
+        for (const auto& exponent : exponents)
+        {
+            uint8_t input[64];
+            intx::be::unsafe::store(&input[0], base);
+            intx::be::unsafe::store(&input[32], exponent);
+            SCOPED_TRACE(to_string(base, 16) + " " + to_string(exponent, 16));
+            execute(code, {input, std::size(input)});
+            ASSERT_EQ(result.status_code, ZVMC_SUCCESS);
+            ASSERT_EQ(output.size(), sizeof(uint256));
+            EXPECT_EQ(intx::be::unsafe::load<uint256>(output.data()), intx::exp(base, exponent));
+        }
+    }
+}
+
 TEST_P(zvm, exp_oog)
 {
     auto code = "6001600003800a";
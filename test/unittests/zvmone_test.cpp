@@ -2,10 +2,14 @@
 // Copyright 2019-2020 The evmone Authors.
 // SPDX-License-Identifier: Apache-2.0
 
+#include "test/utils/bytecode.hpp"
 #include <gtest/gtest.h>
+#include <zvmc/mocked_host.hpp>
 #include <zvmc/zvmc.hpp>
 #include <zvmone/vm.hpp>
 #include <zvmone/zvmone.h>
+#include <cstddef>
+#include <filesystem>
 
 TEST(zvmone, info)
 {
@@ -53,3 +57,342 @@ TEST(zvmone, set_option_cgoto)
     EXPECT_EQ(vm.set_option("cgoto", "no"), ZVMC_SET_OPTION_INVALID_NAME);
 #endif
 }
+
+TEST(zvmone, set_option_unmetered)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    EXPECT_EQ(vm.set_option("unmetered", ""), ZVMC_SET_OPTION_INVALID_VALUE);
+    EXPECT_EQ(vm.set_option("unmetered", "no"), ZVMC_SET_OPTION_INVALID_VALUE);
+    EXPECT_EQ(vm.set_option("unmetered", "yes"), ZVMC_SET_OPTION_SUCCESS);
+}
+
+TEST(zvmone, set_option_memory)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    EXPECT_EQ(vm.set_option("memory", ""), ZVMC_SET_OPTION_INVALID_VALUE);
+    EXPECT_EQ(vm.set_option("memory", "mmap"), ZVMC_SET_OPTION_INVALID_VALUE);
+    EXPECT_EQ(vm.set_option("memory", "virtual"), ZVMC_SET_OPTION_SUCCESS);
+    EXPECT_EQ(vm.set_option("memory", "arena"), ZVMC_SET_OPTION_SUCCESS);
+    EXPECT_EQ(vm.set_option("memory", "heap"), ZVMC_SET_OPTION_SUCCESS);
+
+    // Expand the memory above the heap size limit.
+    zvmc::MockedHost host;
+    zvmc_message msg{};
+    msg.gas = 1'000'000;
+    const auto code = mstore(0x40000, push(1)) + ret(0x40000 - 0x20, 0x40);
+    auto result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    ASSERT_EQ(result.status_code, ZVMC_SUCCESS);
+    ASSERT_EQ(result.output_size, 0x40);
+    EXPECT_EQ(result.output_data[0x1f], 0);
+    EXPECT_EQ(result.output_data[0x3f], 1);
+}
+
+TEST(zvmone, set_option_shared_stack)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    EXPECT_EQ(vm.set_option("shared_stack", ""), ZVMC_SET_OPTION_INVALID_VALUE);
+    EXPECT_EQ(vm.set_option("shared_stack", "yes"), ZVMC_SET_OPTION_SUCCESS);
+    EXPECT_EQ(vm.set_option("shared_stack", "no"), ZVMC_SET_OPTION_SUCCESS);
+
+    zvmc::MockedHost host;
+    zvmc_message msg{};
+    msg.gas = 100;
+    const auto code = mstore(0, add(push(1), push(2))) + ret(0, 32);
+    const auto result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    EXPECT_EQ(result.gas_left, 100 - 24);
+}
+
+TEST(zvmone, set_option_cache_dir)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    EXPECT_EQ(vm.set_option("cache_dir", ""), ZVMC_SET_OPTION_INVALID_VALUE);
+
+    const auto dir = std::filesystem::temp_directory_path() / "zvmone-test-cache-dir";
+    EXPECT_EQ(vm.set_option("cache_dir", dir.string().c_str()), ZVMC_SET_OPTION_SUCCESS);
+
+    zvmc::MockedHost host;
+    zvmc_message msg{};
+    msg.gas = 100;
+    const auto code = mstore(0, add(push(1), push(2))) + ret(0, 32);
+    auto result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    EXPECT_EQ(result.gas_left, 100 - 24);
+
+    ASSERT_EQ(vm.set_option("advanced", ""), ZVMC_SET_OPTION_SUCCESS);
+    result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    EXPECT_EQ(result.gas_left, 100 - 24);
+
+    vm = zvmc::VM{};  // Flush the pending writes.
+    std::filesystem::remove_all(dir);
+}
+
+TEST(zvmone, unmetered_execution)
+{
+    zvmc::VM vm{zvmc_create_zvmone(), {{"unmetered", "yes"}}};
+    zvmc::MockedHost host;
+    zvmc_message msg{};
+
+    // The code requires 24 gas including the memory expansion cost.
+    const auto code = mstore(0, add(push(1), push(2))) + ret(0, 32);
+    msg.gas = 10;
+    auto result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    EXPECT_EQ(result.gas_left, 0);
+    ASSERT_EQ(result.output_size, 32);
+    EXPECT_EQ(result.output_data[31], 3);
+
+    // The gas used is reported relatively to the gas limit.
+    msg.gas = 100;
+    result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    EXPECT_EQ(result.gas_left, 100 - 24);
+
+    // The GAS instruction observes the gas left relative to the gas limit.
+    const auto gas_code = mstore(0, OP_GAS) + ret(0, 32);
+    result = vm.execute(host, ZVMC_SHANGHAI, msg, gas_code.data(), gas_code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    ASSERT_EQ(result.output_size, 32);
+    EXPECT_EQ(result.output_data[31], 100 - 2);
+    EXPECT_EQ(result.output_data[23], 0);
+
+    // Stack checks are still performed.
+    const auto underflow_code = bytecode{OP_ADD};
+    result = vm.execute(host, ZVMC_SHANGHAI, msg, underflow_code.data(), underflow_code.size());
+    EXPECT_EQ(result.status_code, ZVMC_STACK_UNDERFLOW);
+
+    // The memory is limited to the size the gas limit can pay for (32 words for 100 gas).
+    const auto memory_code = mstore(31 * 32, 1) + mstore(0x10000000, 1);
+    result = vm.execute(host, ZVMC_SHANGHAI, msg, memory_code.data(), memory_code.size());
+    EXPECT_EQ(result.status_code, ZVMC_OUT_OF_GAS);
+    EXPECT_EQ(result.gas_left, 0);
+    const auto memory_ok_code = mstore(31 * 32, 1);
+    result = vm.execute(host, ZVMC_SHANGHAI, msg, memory_ok_code.data(), memory_ok_code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+}
+
+TEST(zvmone, unmetered_execution_not_in_advanced)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    EXPECT_EQ(vm.set_option("unmetered", "yes"), ZVMC_SET_OPTION_SUCCESS);
+    EXPECT_EQ(vm.set_option("advanced", ""), ZVMC_SET_OPTION_INVALID_VALUE);
+
+    zvmc::VM advanced_vm{zvmc_create_zvmone(), {{"advanced", ""}}};
+    EXPECT_EQ(advanced_vm.set_option("unmetered", "yes"), ZVMC_SET_OPTION_INVALID_VALUE);
+}
+
+TEST(zvmone, set_option_storage_cache)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    EXPECT_EQ(vm.set_option("storage_cache", ""), ZVMC_SET_OPTION_INVALID_VALUE);
+    EXPECT_EQ(vm.set_option("storage_cache", "no"), ZVMC_SET_OPTION_SUCCESS);
+
+    zvmc_message msg{};
+    msg.gas = 100'000;
+    const auto code = sstore(1, 2) + mstore(0, sload(1)) + mstore(32, sload(2)) +
+                      mstore(64, sload(2)) + ret(0, 96);
+    zvmc::MockedHost uncached_host;
+    const auto expected = vm.execute(uncached_host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    ASSERT_EQ(expected.status_code, ZVMC_SUCCESS);
+
+    EXPECT_EQ(vm.set_option("storage_cache", "yes"), ZVMC_SET_OPTION_SUCCESS);
+    for (const auto advanced : {false, true})
+    {
+        if (advanced)
+            ASSERT_EQ(vm.set_option("advanced", ""), ZVMC_SET_OPTION_SUCCESS);
+
+        zvmc::MockedHost host;
+        const auto result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+        ASSERT_EQ(result.status_code, ZVMC_SUCCESS);
+        EXPECT_EQ(result.gas_left, expected.gas_left);
+        ASSERT_EQ(result.output_size, 96);
+        EXPECT_EQ(result.output_data[31], 2);
+        EXPECT_EQ(result.output_data[63], 0);
+        EXPECT_EQ(result.output_data[95], 0);
+    }
+
+    // The SLOAD of the stored slot and the second SLOAD of the slot 2 are served from the cache.
+    const auto stats =
+        static_cast<const zvmone::VM*>(vm.get_raw_pointer())->get_storage_cache_stats();
+    EXPECT_EQ(stats.hits, 2 * 2);
+    EXPECT_EQ(stats.misses, 2 * 1);
+}
+
+TEST(zvmone, storage_cache_invalidated_by_call)
+{
+    /// The host modifying the storage of the caller in the call as the reentrant call would.
+    class ReentrantHost : public zvmc::MockedHost
+    {
+    public:
+        zvmc::Result call(const zvmc_message& msg) noexcept override
+        {
+            accounts[msg.sender].storage[zvmc::bytes32{1}] = zvmc::bytes32{2};
+            return MockedHost::call(msg);
+        }
+    };
+
+    zvmc::VM vm{zvmc_create_zvmone(), {{"storage_cache", "yes"}}};
+    ReentrantHost host;
+    zvmc_message msg{};
+    msg.gas = 100'000;
+    host.accounts[msg.recipient].storage[zvmc::bytes32{1}] = zvmc::bytes32{1};
+
+    const auto code = mstore(0, sload(1)) + mstore(32, sload(1)) + call(0xaa).gas(0xffff) +
+                      OP_POP + mstore(64, sload(1)) + ret(0, 96);
+    const auto result = vm.execute(host, ZVMC_SHANGHAI, msg, code.data(), code.size());
+    ASSERT_EQ(result.status_code, ZVMC_SUCCESS);
+    ASSERT_EQ(result.output_size, 96);
+    EXPECT_EQ(result.output_data[31], 1);
+    EXPECT_EQ(result.output_data[63], 1);
+    EXPECT_EQ(result.output_data[95], 2);
+}
+
+namespace
+{
+zvmc_access_status access_and_get_storage(zvmc_host_context* /*context*/,
+    const zvmc_address* /*address*/, const zvmc_bytes32* /*key*/, zvmc_bytes32* /*value*/) noexcept
+{
+    return ZVMC_ACCESS_COLD;
+}
+
+zvmc_access_status access_and_set_storage(zvmc_host_context* /*context*/,
+    const zvmc_address* /*address*/, const zvmc_bytes32* /*key*/, const zvmc_bytes32* /*value*/,
+    zvmc_storage_status* /*status*/) noexcept
+{
+    return ZVMC_ACCESS_COLD;
+}
+
+void call_preflight(zvmc_host_context* /*context*/, const zvmc_address* /*sender*/,
+    const zvmc_address* /*destination*/, const zvmc_uint256be* /*value*/,
+    zvmone_call_preflight* /*result*/) noexcept
+{}
+
+int counted_call_preflights = 0;
+
+void counting_call_preflight(zvmc_host_context* /*context*/, const zvmc_address* /*sender*/,
+    const zvmc_address* /*destination*/, const zvmc_uint256be* /*value*/,
+    zvmone_call_preflight* result) noexcept
+{
+    ++counted_call_preflights;
+    *result = {ZVMC_ACCESS_WARM, true, true};
+}
+}  // namespace
+
+TEST(zvmone, host_extension_size)
+{
+    auto* const c_vm = zvmc_create_zvmone();
+    const auto& vm = *static_cast<zvmone::VM*>(c_vm);
+    const zvmc_host_interface host{};
+    const zvmc_host_interface other_host{};
+
+    zvmone_host_extension ext{
+        sizeof(ext), access_and_get_storage, access_and_set_storage, call_preflight};
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &host, &ext));
+    const auto* registered = vm.get_host_extension(&host);
+    ASSERT_NE(registered, nullptr);
+    EXPECT_NE(registered, &ext);  // The extension is copied.
+    EXPECT_EQ(registered->access_and_get_storage, access_and_get_storage);
+    EXPECT_EQ(registered->call_preflight, call_preflight);
+    EXPECT_EQ(vm.get_host_extension(&other_host), nullptr);
+
+    // The host built against the header without call_preflight.
+    ext.size = offsetof(zvmone_host_extension, call_preflight);
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &host, &ext));
+    registered = vm.get_host_extension(&host);
+    ASSERT_NE(registered, nullptr);
+    EXPECT_EQ(registered->access_and_set_storage, access_and_set_storage);
+    EXPECT_EQ(registered->call_preflight, nullptr);
+
+    // The extension without the storage functions is ignored.
+    ext.size = sizeof(ext.size);
+    EXPECT_FALSE(zvmone_set_host_extension(c_vm, &host, &ext));
+    EXPECT_EQ(vm.get_host_extension(&host), nullptr);
+
+    ext.size = sizeof(ext);
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &host, &ext));
+    ASSERT_NE(vm.get_host_extension(&host), nullptr);
+    EXPECT_FALSE(zvmone_set_host_extension(c_vm, &host, nullptr));
+    EXPECT_EQ(vm.get_host_extension(&host), nullptr);
+    EXPECT_EQ(vm.get_host_extension(nullptr), nullptr);
+
+    c_vm->destroy(c_vm);
+}
+
+TEST(zvmone, host_extension_per_host)
+{
+    auto* const c_vm = zvmc_create_zvmone();
+    const auto& vm = *static_cast<zvmone::VM*>(c_vm);
+    std::array<zvmc_host_interface, zvmone::VM::max_extended_hosts + 1> hosts{};
+
+    // The hosts register their extensions independently.
+    zvmone_host_extension ext{
+        sizeof(ext), access_and_get_storage, access_and_set_storage, call_preflight};
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &hosts[0], &ext));
+    ext.call_preflight = nullptr;
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &hosts[1], &ext));
+    ASSERT_NE(vm.get_host_extension(&hosts[0]), nullptr);
+    ASSERT_NE(vm.get_host_extension(&hosts[1]), nullptr);
+    EXPECT_EQ(vm.get_host_extension(&hosts[0])->call_preflight, call_preflight);
+    EXPECT_EQ(vm.get_host_extension(&hosts[1])->call_preflight, nullptr);
+
+    // Registering again replaces only the extension of the host.
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &hosts[1], &ext));
+    EXPECT_EQ(vm.get_host_extension(&hosts[0])->call_preflight, call_preflight);
+
+    // The number of the registered hosts is limited.
+    for (size_t i = 2; i < zvmone::VM::max_extended_hosts; ++i)
+        EXPECT_TRUE(zvmone_set_host_extension(c_vm, &hosts[i], &ext));
+    EXPECT_FALSE(zvmone_set_host_extension(c_vm, &hosts.back(), &ext));
+    EXPECT_EQ(vm.get_host_extension(&hosts.back()), nullptr);
+
+    // The unregistered host frees its slot.
+    zvmone_set_host_extension(c_vm, &hosts[0], nullptr);
+    EXPECT_EQ(vm.get_host_extension(&hosts[0]), nullptr);
+    EXPECT_TRUE(zvmone_set_host_extension(c_vm, &hosts.back(), &ext));
+    EXPECT_NE(vm.get_host_extension(&hosts.back()), nullptr);
+    EXPECT_NE(vm.get_host_extension(&hosts[1]), nullptr);
+
+    c_vm->destroy(c_vm);
+}
+
+TEST(zvmone, call_preflight_per_host)
+{
+    zvmc::VM vm{zvmc_create_zvmone()};
+    auto* const c_vm = vm.get_raw_pointer();
+    const auto counting_host = zvmc::Host::get_interface();
+    const auto other_host = zvmc::Host::get_interface();
+    const auto plain_host = zvmc::Host::get_interface();
+
+    const zvmone_host_extension counting_ext{
+        sizeof(zvmone_host_extension), access_and_get_storage, access_and_set_storage,
+        counting_call_preflight};
+    const zvmone_host_extension other_ext{
+        sizeof(zvmone_host_extension), access_and_get_storage, access_and_set_storage, nullptr};
+    ASSERT_TRUE(zvmone_set_host_extension(c_vm, &counting_host, &counting_ext));
+    ASSERT_TRUE(zvmone_set_host_extension(c_vm, &other_host, &other_ext));
+
+    zvmc_message msg{};
+    msg.gas = 100'000;
+    const bytecode code = call(0xca11).gas(0xffff);
+    counted_call_preflights = 0;
+
+    // The CALL uses the preflight of the host it is executed with.
+    zvmc::MockedHost host;
+    auto result = vm.execute(
+        counting_host, host.to_context(), ZVMC_SHANGHAI, msg, code.data(), code.size());
+    EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+    EXPECT_EQ(counted_call_preflights, 1);
+    EXPECT_TRUE(host.recorded_account_accesses.empty());
+
+    // The other hosts are not affected.
+    for (const auto* iface : {&other_host, &plain_host})
+    {
+        host.recorded_account_accesses.clear();
+        result = vm.execute(
+            *iface, host.to_context(), ZVMC_SHANGHAI, msg, code.data(), code.size());
+        EXPECT_EQ(result.status_code, ZVMC_SUCCESS);
+        EXPECT_EQ(counted_call_preflights, 1);
+        EXPECT_FALSE(host.recorded_account_accesses.empty());
+    }
+}